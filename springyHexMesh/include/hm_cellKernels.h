@@ -0,0 +1,160 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+#include <tm_math.h>
+
+#include <utility>
+#include <type_traits>
+
+#include <hm_types.h>
+#include <hm_tables.h>
+
+/*
+Cell kernels which are unrolled over corners, edges and faces at compile time.
+The topology comes from the constexpr tables, so each index below is a compile time constant and there is no table lookup at run time.
+Points are the cell's 8 corners ordered by CellVertPos.
+*/
+
+namespace HexahedralMesher {
+	namespace CellKernels {
+
+		template<size_t I>
+		using Index = std::integral_constant<size_t, I>;
+
+		template<typename FUNC, size_t... I>
+		inline double sumImpl(FUNC& func, std::index_sequence<I...>) {
+			return (func(Index<I>()) + ...);
+		}
+
+		// Sum of func(Index<0>()) ... func(Index<N - 1>())
+		template<size_t N, typename FUNC>
+		inline double sum(FUNC func) {
+			return sumImpl(func, std::make_index_sequence<N>());
+		}
+
+		template<typename FUNC, size_t... I>
+		inline void forEachImpl(FUNC& func, std::index_sequence<I...>) {
+			(func(Index<I>()), ...);
+		}
+
+		template<size_t N, typename FUNC>
+		inline void forEach(FUNC func) {
+			forEachImpl(func, std::make_index_sequence<N>());
+		}
+
+		// Compression, k * (length - restLength)^2 summed over the 12 edges
+		template<typename REST_LEN_FUNC>
+		inline double compressionEnergy(const Vector3d pts[8], REST_LEN_FUNC restLen, double k) {
+			return sum<12>([&](auto edge)->double {
+				constexpr CellVertPos v0 = gEdgeVerts[edge][0];
+				constexpr CellVertPos v1 = gEdgeVerts[edge][1];
+				double deltaL = (pts[v1] - pts[v0]).norm() - restLen(edge);
+				return k * deltaL * deltaL;
+			});
+		}
+
+		// Edge vectors leaving a corner, in gOrientedEdgePosLT order. Not normalized, the dot model divides by their squared lengths.
+		template<size_t CORNER>
+		inline void cornerEdgeVectors(const Vector3d pts[8], Vector3d edgeVecs[3]) {
+			forEach<3>([&](auto i) {
+				constexpr CellVertPos pos = gOrientedEdgePosLT[CORNER][i].pos;
+				edgeVecs[i] = pts[pos] - pts[CORNER];
+			});
+		}
+
+		// Angle model, k * (theta / pi)^2 for the angle between each edge and the normal of the other two
+		inline double bendEnergyAngle(const Vector3d pts[8], double k) {
+			return sum<8>([&](auto corner)->double {
+				Vector3d edgeDirs[3];
+				cornerEdgeVectors<decltype(corner)::value>(pts, edgeDirs);
+				for (auto& dir : edgeDirs)
+					dir.normalize();
+
+				return sum<3>([&](auto i)->double {
+					const Vector3d& vI = edgeDirs[i];
+					const Vector3d& vJ = edgeDirs[(i + 1) % 3];
+					const Vector3d& vK = edgeDirs[(i + 2) % 3];
+
+					Vector3d normal = vI.cross(vJ);
+					double theta = atan2(normal.cross(vK).norm(), normal.dot(vK)) / EIGEN_PI;
+					return k * theta * theta;
+				});
+			});
+		}
+
+		// Dot product model, see GridEnergy::calcBendEnergyDotProduct
+		inline double bendEnergyDotProduct(const Vector3d pts[8], double kPair, double kInverted) {
+			return sum<8>([&](auto corner)->double {
+				Vector3d edgeVecs[3];
+				cornerEdgeVectors<decltype(corner)::value>(pts, edgeVecs);
+				double lenSqr[3] = {
+					edgeVecs[0].squaredNorm(),
+					edgeVecs[1].squaredNorm(),
+					edgeVecs[2].squaredNorm(),
+				};
+				if (lenSqr[0] < minNormalizeDivisor || lenSqr[1] < minNormalizeDivisor || lenSqr[2] < minNormalizeDivisor)
+					throw "Degenerate cell edge";
+
+				double result = sum<3>([&](auto i)->double {
+					constexpr size_t j = (i + 1) % 3;
+					double dp = edgeVecs[i].dot(edgeVecs[j]);
+					return kPair * dp * dp / (lenSqr[i] * lenSqr[j]);
+				});
+
+				double det = edgeVecs[0].cross(edgeVecs[1]).dot(edgeVecs[2]);
+				if (det < 0)
+					result += kInverted * det * det / (lenSqr[0] * lenSqr[1] * lenSqr[2]);
+				return result;
+			});
+		}
+
+		// Triangle points of one face, ordered as gFaceTriPosLUT
+		template<size_t FACE, typename PT_FUNC>
+		inline void faceTriPoints(PT_FUNC getPt, const Vector3d* triPoints[2][3]) {
+			forEach<2>([&](auto tri) {
+				forEach<3>([&](auto i) {
+					triPoints[tri][i] = &getPt(gFaceTriPosLUT[FACE][tri][i]);
+				});
+			});
+		}
+
+		// Sum of the signed volumes under the 12 face triangles
+		inline double volume(const Vector3d pts[8]) {
+			return sum<6>([&](auto face)->double {
+				const Vector3d* tris[2][3];
+				faceTriPoints<decltype(face)::value>([&](CellVertPos pos)->const Vector3d& { return pts[pos]; }, tris);
+				return volumeUnderTriangle(tris[0], vZ) + volumeUnderTriangle(tris[1], vZ);
+			});
+		}
+
+	}
+}
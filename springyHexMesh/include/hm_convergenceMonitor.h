@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <vector>
+
+namespace HexahedralMesher {
+
+	enum StopReason {
+		STOP_NONE,
+		STOP_MAX_ITERATIONS,
+		STOP_MOVE_TOLERANCE,	// The largest move fell below the move tolerance
+		STOP_ENERGY_TOLERANCE,	// The relative energy decrease over the window fell below the energy tolerance
+		STOP_STALLED,			// The energy didn't decrease over the window
+		STOP_ACTIVE_SET_EMPTY,	// No vertex was active
+		STOP_TIME_LIMIT,		// The wall clock budget was used up
+		STOP_TARGET_ENERGY,		// The energy reached the caller's target
+	};
+
+	/*
+	Decides when an iterative mesh minimization has stopped making progress.
+	Call update once per iteration with that iteration's statistics. It keeps the total energy of the last window + 1 iterations.
+	*/
+	class CConvergenceMonitor {
+	public:
+		struct Params {
+			double moveTol = 0;		// Absolute distance, 0 disables
+			double energyTol = 0;	// Relative decrease over the window, 0 disables
+			bool stopOnStall = false;	// Stop when the energy didn't decrease over the window. Only for solvers whose energy never rises.
+			size_t window = 5;
+		};
+
+		CConvergenceMonitor(const Params& params);
+
+		// Returns true if the iterations should stop
+		bool update(double maxMove, double totalEnergy);
+		void setStopReason(StopReason reason);
+
+		StopReason getStopReason() const;
+		size_t numIterations() const;
+		double getRelativeDecrease() const; // Over the current window, 0 until the window is full
+
+		static const char* getStopReasonStr(StopReason reason);
+		// True for the tolerance and stall stops, false for running out of iterations or time
+		static bool isConverged(StopReason reason);
+
+	private:
+		Params _params;
+		StopReason _stopReason = STOP_NONE;
+		size_t _numIterations = 0;
+		double _relativeDecrease = 0;
+		std::vector<double> _energyHistory; // Ring buffer of window + 1 energies
+	};
+
+	inline StopReason CConvergenceMonitor::getStopReason() const {
+		return _stopReason;
+	}
+
+	inline size_t CConvergenceMonitor::numIterations() const {
+		return _numIterations;
+	}
+
+	inline double CConvergenceMonitor::getRelativeDecrease() const {
+		return _relativeDecrease;
+	}
+
+}
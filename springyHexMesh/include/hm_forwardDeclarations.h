@@ -56,6 +56,7 @@ namespace HexahedralMesher {
 	using GridConstPtr = std::shared_ptr<const Grid>;
 
 	struct ParamsRec;
+	struct KnownValues;
 
 	class CModel;
 	using CModelPtr = std::shared_ptr<CModel>;
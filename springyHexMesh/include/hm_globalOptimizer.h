@@ -0,0 +1,122 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <vector>
+
+#include <hm_types.h>
+#include <hm_forwardDeclarations.h>
+#include <hm_grid.h>
+#include <hm_polylineArcLength.h>
+
+namespace HexahedralMesher {
+
+	/*
+	L-BFGS or FIRE over the degrees of freedom of every movable vertex in the grid, as one vector.
+	Free vertices have 3, perpendicular and grid tri plane clamps have 2 tangent coordinates,
+	parallel clamps have 1 along the clamp vector and edge clamps have 1, the arc length along their polyline.
+	The energy and gradient come from the threaded Grid::calcEnergyField pass.
+	Vertices clamped to cell edge and face centers follow their cells after every move, they aren't degrees of freedom.
+	*/
+	class CGlobalOptimizer {
+	public:
+		using VectorXd = Eigen::VectorXd;
+
+		CGlobalOptimizer(Grid& grid, MeshSolver solver, int clampMask, int numThreads, int historySize = 7);
+
+		size_t numDofs() const;
+		double getEnergy() const;
+		size_t getNumEvaluations() const;
+		// Energy field at the current positions
+		const Grid::EnergyField& getEnergyField() const;
+
+		// One iteration of the solver. Returns false if it can't reduce the energy.
+		bool step();
+
+	private:
+		struct DofRec {
+			size_t _vertIdx;
+			size_t _offset;
+			int _numDofs;
+			Vector3d _origin;
+			Vector3d _axes[3];
+			double _maxMove;
+			const PolylineArcLength* _arcLength = nullptr;
+		};
+
+		void buildDofMap(int clampMask);
+		void getDofs(VectorXd& x) const;
+		void setDofs(VectorXd& x);
+		double evaluate(const VectorXd& x, VectorXd& grad);
+		void calcDirection(VectorXd& dir) const;
+		// Returns the scale applied to dir
+		double limitStep(VectorXd& dir) const;
+		bool lineSearch(const VectorXd& dir);
+		bool stepLBFGS();
+		bool stepFIRE();
+
+		Grid& _grid;
+		MeshSolver _solver;
+		int _numThreads;
+		size_t _historySize;
+		size_t _numDofs = 0;
+		size_t _numEvaluations = 0;
+		std::vector<DofRec> _dofs;
+		Grid::EnergyField _field;
+
+		double _energy = 0;
+		VectorXd _x, _grad;
+		std::vector<VectorXd> _s, _y; // Step and gradient change history, oldest first
+
+		// FIRE state
+		VectorXd _velocity;
+		double _fireDt = 0, _fireDtMin = 0, _fireDtMax = 0, _fireAlpha = 0;
+		int _fireNumPositive = 0;
+	};
+
+	inline size_t CGlobalOptimizer::numDofs() const {
+		return _numDofs;
+	}
+
+	inline double CGlobalOptimizer::getEnergy() const {
+		return _energy;
+	}
+
+	inline size_t CGlobalOptimizer::getNumEvaluations() const {
+		return _numEvaluations;
+	}
+
+	inline const Grid::EnergyField& CGlobalOptimizer::getEnergyField() const {
+		return _field;
+	}
+
+}
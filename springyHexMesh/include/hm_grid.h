@@ -35,6 +35,7 @@ This file is part of the SpringHexMesh Project.
 
 #include <hm_forwardDeclarations.h>
 #include <hm_gridBase.h>
+#include <hm_gridCellEnergy.h>
 
 namespace HexahedralMesher {
 
@@ -43,11 +44,26 @@ namespace HexahedralMesher {
 	class Grid : public GridBase, public std::enable_shared_from_this<Grid> {
 		friend class GridCell;
 	public:
+		// Energy and energy gradient of the whole grid at the primary vertex positions, indexed by cell id and vertex index.
+		struct EnergyField {
+			std::vector<double> _cellEnergy;
+			std::vector<double> _vertEnergy;
+			std::vector<Vector3d> _vertGradient;
+
+			// Gradient of each cell's energy with respect to each of its corners, [cellId * 8 + CellVertPos]
+			std::vector<Vector3d> _cellCornerGradient;
+		};
 
 		Grid(CMesher& mesher);
 
 		void init(const BoundingBox& bbox);
 		bool verify() const;
+		bool verify(VerifyReport& report, int numCores = 6) const;
+		// Same checks as verify, on the vertices and cells changed since the last successful verify
+		bool verifyChanges() const;
+		bool verifyChanges(VerifyReport& report) const;
+		// Reports an edge clamped vertex off its polyline or on the wrong segment
+		void verifyClampPosition(size_t vertIdx, VerifyReport& report) const;
 
 		const CMesher& getMesher() const;
 		CMesher& getMesher();
@@ -56,20 +72,73 @@ namespace HexahedralMesher {
 		GridConstPtr getSelf() const;
 
 		const ParamsRec& getParams() const;
+		GridEnergy::Params getEnergyParams() const;
 		size_t getVertsFaces(size_t vertIdx, bool includeOpposedPairs, std::vector<GridFace>& faceRefs) const;
 		double calcCellEnergy(size_t cellId) const;
 		double calcVertexEnergy(size_t vertIdx) const;
 		double calcVertexEnergyAtPos(size_t vertIdx, const Vector3d& atPos);
+		// Energy with the vertex at each of the points. The vertex's cells are gathered once for all the points.
+		void calcVertexEnergyAtPositions(size_t vertIdx, const Vector3d pts[], int numPts, double energies[]) const;
 		double calcVertexOrthoEnergy(size_t vertIdx) const;
 		double calcVertexOrthoEnergyAtPos(size_t vertIdx, const Vector3d& atPos);
 		Vector3d calcTriangleCentroid(size_t vertIdx[3]) const;
 
+		void calcEnergyField(EnergyField& field, int numThreads, bool calcGradient = true, double dt = 1.0e-8) const;
+		double calcTotalEnergy(const EnergyField& field) const;
+
 		double minimizeVertexEnergy(std::ostream& logOut, size_t vertIdx, int clampMask);
+		// Vertex energy evaluations made by minimizeVertexEnergy, from all threads
+		static size_t getNumVertexEvaluations();
+		static void resetNumVertexEvaluations();
 
 		double clampVertex(size_t vertIdx);
 		double clampVertexToTriPlane(size_t vertIdx);
+		// Projects a CLAMP_TRI vertex onto the closest model triangle and records the triangle in the clamp
+		double clampVertexToSurface(size_t vertIdx);
+		Vector3d projectToSurface(size_t vertIdx, const Vector3d& pt, size_t& triIdx) const;
 		double clampVertexToCellEdgeCenter(size_t vertIdx);
 		double clampVertexToCellFaceCenter(size_t vertIdx);
+		// Moves the vertices clamped to cell edge centers, cell face centers and grid tri planes back onto their clamps, in the calling thread
+		void clampDependentVerts();
+		// Same, limited to the dependents of movedVerts and the grid tri plane vertices in nearVerts. Needs the dependent table.
+		void clampDependentVerts(const std::vector<size_t>& movedVerts, const std::vector<size_t>& nearVerts);
+
+		/*
+		Vertices clamped to cell edge and face centers are dependent, their points are the average of their master vertices.
+		While the table is built, each dependent is placed in one pass, masters before dependents, and the vertex solvers move
+		the dependents with their masters when they evaluate the energy. Rebuild it after the clamps or topology change.
+		*/
+		struct DependentWeight {
+			size_t _vertIdx;
+			double _weight;
+		};
+
+		void buildDependentVerts();
+		void clearDependentVerts();
+
+		// Builds the table for the life of a minimization, it's cleared even if the minimization is stopped
+		struct ScopedDependentVerts {
+			ScopedDependentVerts(Grid& grid);
+			~ScopedDependentVerts();
+
+			Grid& _grid;
+		};
+
+		bool hasDependentVerts() const;
+		// The dependents which move with vertIdx, including dependents of dependents. Returns the count.
+		size_t getDependentVerts(size_t vertIdx, const DependentWeight*& deps) const;
+
+		// Tangent frame of a CLAMP_PERPENDICULAR, CLAMP_GRID_TRI_PLANE or CLAMP_TRI vertex
+		struct ConstraintFrame {
+			Vector3d _normal, _xAxis, _yAxis;
+		};
+
+		// Perpendicular frames are kept until the clamps change, tri plane frames follow their triangles and are refreshed on every call. Call once per sweep.
+		void updateConstraintFrames();
+		// Refreshes only the tri plane frames of vertIndices, for callers which move a few vertices at a time
+		void updateConstraintFrames(const std::vector<size_t>& vertIndices);
+		// Uses the table when it has the vertex, otherwise the frame is calculated from the current points. CLAMP_TRI frames come from the model triangle.
+		void getConstraintFrame(size_t vertIdx, ConstraintFrame& frame) const;
 
 	private:
 		struct ScopedSetStash {
@@ -79,24 +148,76 @@ namespace HexahedralMesher {
 			Grid& _grid;
 			size_t _vertIdx;
 			Vector3d _pt;
+			size_t _changeNumber;
 			TopolRef _clamp;
 		};
 
 		template<typename GRAD_FUNC, typename LOG_FUNC>
 		double minimizeVertexEnergy(size_t vertIdx, LOG_FUNC logFunc, GRAD_FUNC gradFunc);
 
-		double calcEnergyGradientFree(size_t vertIdx, double dt, Vector3d& gradient);
-		double calcEnergyGradientPerpendicular(size_t vertIdx, const Vector3d& normal, double dt, Vector3d& gradient);
-		double calcEnergyGradientTriPlane(size_t vertIdx, double dt, Vector3d& gradient);
-		double calcEnergyGradientEdge(size_t vertIdx, double dt, Vector3d& gradient);
-		int chooseBestGradient(size_t vertIdx, double dt, const Vector3d gradients[], int numGradients);
+		// Newton/trust region alternative to the steepest descent solver, selected by ParamsRec::vertexSolver
+		template<typename LOG_FUNC>
+		double minimizeVertexEnergyNewton(size_t vertIdx, LOG_FUNC logFunc);
 
-		double calcMoveDist(size_t vertIdx, double dt, const Vector3d& gradient);
-		void fixGradientDirection(size_t vertIdx, double dt, Vector3d& gradient);
+		// Reduced coordinate solvers for clamped vertices, selected by VS_REDUCED. 1D golden section on lines and edges, 2D Newton on planes.
+		template<typename LOG_FUNC>
+		double minimizeVertexEnergyReduced(size_t vertIdx, LOG_FUNC logFunc);
+
+		template<typename MAP_FUNC, typename LOG_FUNC>
+		double minimizeVertexEnergyLine(size_t vertIdx, double start, double lower, double upper, MAP_FUNC toPoint, LOG_FUNC logFunc);
+
+		// toPoint maps the local coordinates of the clamp manifold to a point
+		template<int DIM, typename MAP_FUNC, typename LOG_FUNC>
+		double minimizeVertexEnergyNewton(size_t vertIdx, const Eigen::Matrix<double, DIM, 1>& start,
+			const Eigen::Matrix<double, DIM, 1>& lower, const Eigen::Matrix<double, DIM, 1>& upper, MAP_FUNC toPoint, LOG_FUNC logFunc);
+
+		// The gradient functions record the values they evaluate in known, for the line search to reuse
+		double calcEnergyGradientFree(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known);
+		double calcEnergyGradientPerpendicular(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known);
+		double calcEnergyGradientSurface(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known);
+		double calcEnergyGradientEdge(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known);
+		int chooseBestGradient(size_t vertIdx, double dt, const Vector3d gradients[], int numGradients, KnownValues& known);
+
+		struct DependentRec {
+			size_t _vertIdx;
+			int _numMasters;
+			size_t _masters[4];
+		};
+
+		void calcConstraintFrame(size_t vertIdx, ConstraintFrame& frame) const;
+		void placeDependentVert(const DependentRec& rec);
+		void calcVertexEnergyAtPositionsWithDependents(size_t vertIdx, const Vector3d pts[], int numPts, double energies[],
+			const DependentWeight* deps, size_t numDeps) const;
 
 		CMesher* _mesher;
+
+		bool _dependentVertsBuilt = false;
+		std::vector<DependentRec> _dependentOrder; // Masters are placed before their dependents
+		std::vector<size_t> _dependentRecIdx; // Index into _dependentOrder by vertex, SIZE_MAX if the vertex isn't a dependent
+		std::vector<size_t> _triPlaneVerts;
+		// Dependents of master i are _dependentWeights[_dependentStart[i]] to _dependentWeights[_dependentStart[i + 1] - 1]
+		std::vector<size_t> _dependentStart;
+		std::vector<DependentWeight> _dependentWeights;
+
+		size_t _constraintFramesChangeNumber = SIZE_MAX;
+		std::vector<size_t> _constraintFrameIdx; // Index into _constraintFrames by vertex, SIZE_MAX if the vertex has none
+		std::vector<ConstraintFrame> _constraintFrames;
 	};
 
+	inline bool Grid::hasDependentVerts() const {
+		return _dependentVertsBuilt;
+	}
+
+	inline size_t Grid::getDependentVerts(size_t vertIdx, const DependentWeight*& deps) const {
+		if (!_dependentVertsBuilt) {
+			deps = nullptr;
+			return 0;
+		}
+		size_t start = _dependentStart[vertIdx];
+		deps = _dependentWeights.data() + start;
+		return _dependentStart[vertIdx + 1] - start;
+	}
+
 	inline GridPtr Grid::getSelf() {
 		return shared_from_this();
 	}
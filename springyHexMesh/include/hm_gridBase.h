@@ -50,6 +50,7 @@ This file is part of the SpringHexMesh Project.
 #include <hm_topolRef.h>
 #include <hm_gridCell.h>
 #include <hm_gridVert.h>
+#include <hm_verifyReport.h>
 
 namespace HexahedralMesher {
 
@@ -61,6 +62,13 @@ namespace HexahedralMesher {
 	public:
 		using SearchTree = CSpatialSearchST<BoundingBox>;
 
+		// An oct split, kept after the parent cell is deleted so the optimizer can work on the coarser level.
+		// Children are indexed by the parent corner they contain.
+		struct CellSplitRec {
+			size_t _parentCorners[8];
+			size_t _children[8];
+		};
+
 		static int getThreadNumber();
 
 		GridBase();
@@ -83,6 +91,8 @@ namespace HexahedralMesher {
 		void rebuildVertTree() const;
 		size_t numVerts() const;
 		size_t numClampedVerts() const;
+		// Number of vertices whose clamp type is in clampMask
+		size_t numVertsOfType(int clampMask) const;
 
 		size_t numCells() const;
 		bool cellExists(size_t cellIdx) const;
@@ -93,25 +103,82 @@ namespace HexahedralMesher {
 
 		void clearSearchTrees();
 
+		void addSplitRec(const CellSplitRec& rec);
+		const std::vector<CellSplitRec>& getSplitHierarchy() const;
+		// False once any of the children has been split or deleted
+		bool isSplitRecValid(const CellSplitRec& rec) const;
+
+		// Checks every cell and vertex, the report is printed if it found anything
 		bool verify() const;
+		// The checks run on numCores threads which read the primary points
+		bool verify(VerifyReport& report, int numCores = 6) const;
+		/*
+		Checks only the vertices and cells changed since the last successful verify, and the neighbors whose checks depend on them.
+		Falls back to verify if there hasn't been a successful one.
+		*/
+		bool verifyChanges() const;
+		bool verifyChanges(VerifyReport& report) const;
 		bool verifyVertCount(size_t delta = 0) const;
 
+		void setValidationTier(ValidationTier tier, double sampleRate = 0.01);
+		ValidationTier getValidationTier() const;
+		// The checks a mutation should run, VT_OFF, VT_FULL or VT_PARANOID. VT_SAMPLED draws VT_PARANOID or VT_OFF at the sample rate.
+		ValidationTier sampleValidationTier() const;
+
+		// Records a vertex or cell whose topology or clamp changed, for verifyChanges. Moves are found from the change numbers. Main thread only.
+		void journalVert(size_t vertIdx) const;
+		void journalCell(size_t cellId) const;
+
 		template <typename FUNC>
 		void iterateCells(FUNC func);
 
 		template <typename FUNC>
 		void iterateCells(FUNC func) const;
 
+		// Each thread visits a contiguous block of cells, func must not write anything shared by another cell.
+		template <typename FUNC>
+		void iterateCells(FUNC func, int numCores) const;
+
 		template <typename FUNC>
 		void iterateVerts(FUNC func, int numCores = 1);
 
 		template <typename FUNC>
 		void iterateVerts(FUNC func, int numCores = 1) const;
 
+		// Visits only the listed vertices, threads are numbered as in iterateVerts
+		template <typename FUNC>
+		void iterateVertList(const std::vector<size_t>& vertIndices, FUNC func, int numCores = 1) const;
+
+		/*
+		Visits only the vertices whose clamp type is in clampMask, using lists of the vertices of each clamp type.
+		The lists are rebuilt, by the calling thread, when a clamp type has changed since they were built. Call from the main thread.
+		The vertices visited are the ones matching on entry, func may change their clamps.
+		*/
+		template <typename FUNC>
+		void iterateVertsOfType(int clampMask, FUNC func, int numCores = 1) const;
+
 		void dumpText(std::ostream& out) const;
 
+	protected:
+		// Journaled and moved entities, with the cells of changed vertices and the vertices of changed cells
+		void findChanges(std::vector<size_t>& vertIndices, std::vector<size_t>& cellIds) const;
+		void verifyEntities(const std::vector<size_t>& vertIndices, const std::vector<size_t>& cellIds, VerifyReport& report) const;
+		void verifyCell(size_t cellId, VerifyReport& report) const;
+		void verifyVert(size_t vertIdx, VerifyReport& report) const;
+		void getVertsOfType(int clampMask, std::vector<size_t>& vertIndices) const;
+
+		// Calls func(i) for i in [0, num) on numCores threads. The threads keep thread index 0, so they read the primary points.
+		template <typename FUNC>
+		void iteratePrimary(size_t num, FUNC func, int numCores) const;
+		bool isJournalValid() const;
+		// Marks the current state verified
+		void clearJournal() const;
+		void invalidateJournal();
+
 	private:
 		bool readVersion1(std::istream& in);
+		bool readVersion2(std::istream& in);
+		void updateClampBuckets() const;
 
 		size_t add(const GridVert& vert);
 
@@ -119,8 +186,24 @@ namespace HexahedralMesher {
 
 		std::vector<size_t> _cellIndexMap;
 		std::vector<GridCell> _cellStorage;
+		std::vector<CellSplitRec> _splitHierarchy;
 
 		mutable SearchTree _vertTree;
+
+		// Vertex indices by clamp type, bucket i holds clamp type 1 << (i - 1) and bucket 0 CLAMP_UNKNOWN
+		static const int NUM_CLAMP_BUCKETS = 11;
+		mutable std::vector<size_t> _clampBuckets[NUM_CLAMP_BUCKETS];
+		mutable size_t _clampBucketsChangeNumber = SIZE_MAX;
+		mutable size_t _clampBucketsNumVerts = 0;
+
+		// Changes since the last successful verify. Vertices with a primary change number at or above _verifiedChangeNumber have moved.
+		mutable bool _journalValid = false;
+		mutable size_t _verifiedChangeNumber = 0;
+		mutable std::vector<size_t> _vertJournal, _cellJournal;
+		mutable std::vector<char> _vertJournaled, _cellJournaled;
+
+		ValidationTier _validationTier = VT_FULL;
+		double _validationSampleRate = 0.01;
 	};
 
 	inline void GridBase::setThreadNumber(int threadNumber) {
@@ -131,6 +214,14 @@ namespace HexahedralMesher {
 		return GridVert::getThreadNumber();
 	}
 
+	inline void GridBase::addSplitRec(const CellSplitRec& rec) {
+		_splitHierarchy.push_back(rec);
+	}
+
+	inline const std::vector<GridBase::CellSplitRec>& GridBase::getSplitHierarchy() const {
+		return _splitHierarchy;
+	}
+
 	inline size_t GridBase::numVerts() const {
 		return _verts.size();
 	}
@@ -147,6 +238,14 @@ namespace HexahedralMesher {
 		return _verts[idx];
 	}
 
+	inline ValidationTier GridBase::getValidationTier() const {
+		return _validationTier;
+	}
+
+	inline bool GridBase::isJournalValid() const {
+		return _journalValid;
+	}
+
 	inline bool GridBase::cellExists(size_t cellIdx) const {
 		return _cellIndexMap[cellIdx] != stm1;
 	}
@@ -200,17 +299,19 @@ namespace HexahedralMesher {
 		void runSelf() {
 			GridBase::setThreadNumber(_threadNum); // Entry zero is for primary storage
 			for (size_t vertIdx = _start; vertIdx < _end; vertIdx++) {
-				if (vertIdx % _numThreads == _threadNum)
+				if (!_interleaved || vertIdx % _numThreads == _threadNum)
 					_func(vertIdx);
 			}
 		}
 	public:
-		IterVertThread(int numThreads, int threadNum, FUNC func, size_t start, size_t end)
+		// Interleaved threads take every numThreads'th index in [start, end), otherwise the thread takes all of [start, end)
+		IterVertThread(int numThreads, int threadNum, FUNC func, size_t start, size_t end, bool interleaved = true)
 			: _numThreads(numThreads)
 			, _threadNum(threadNum)
-			, _func(func)
 			, _start(start)
 			, _end(end)
+			, _interleaved(interleaved)
+			, _func(func)
 			, _thread(run, (void*)this)
 		{}
 
@@ -218,12 +319,66 @@ namespace HexahedralMesher {
 			return _thread;
 		}
 
-		std::thread _thread;
+		// The thread must be constructed last, it starts running immediately
 		int _numThreads, _threadNum;
 		size_t _start, _end;
+		bool _interleaved;
 		FUNC _func;
+		std::thread _thread;
 	};
 
+	template <typename FUNC>
+	inline void GridBase::iteratePrimary(size_t num, FUNC func, int numCores) const {
+		if (numCores < 2) {
+			for (size_t i = 0; i < num; i++)
+				func(i);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		size_t steps = num / numCores + 1;
+		for (size_t start = 0; start < num; start += steps) {
+			size_t end = std::min(start + steps, num);
+			threads.push_back(std::thread([&func, start, end]() {
+				for (size_t i = start; i < end; i++)
+					func(i);
+			}));
+		}
+		for (auto& thread : threads)
+			thread.join();
+	}
+
+	template <typename FUNC>
+	inline void GridBase::iterateCells(FUNC func, int numCores) const {
+		if (numCores < 2) {
+			iterateCells(func);
+			return;
+		}
+
+		auto cellFunc = [this, &func](size_t cellIdx)->bool {
+			if (_cellIndexMap[cellIdx] != stm1)
+				return func(cellIdx);
+			return true;
+		};
+		using CELL_FUNC = decltype(cellFunc);
+
+		std::vector<std::shared_ptr<IterVertThread<CELL_FUNC>>> threads;
+		size_t numCells = _cellIndexMap.size();
+		size_t steps = numCells / numCores + 1;
+		size_t start = 0;
+		for (int i = 0; i < numCores; i++) {
+			size_t end = start + steps;
+			if (end > numCells)
+				end = numCells;
+			threads.push_back(std::make_shared<IterVertThread<CELL_FUNC>>(numCores, i, cellFunc, start, end, false));
+			start = end;
+		}
+
+		for (auto& thread : threads) {
+			thread->getThread().join();
+		}
+	}
+
 	template <typename FUNC>
 	inline void GridBase::iterateVerts(FUNC func, int numCores) {
 		if (numCores < 2) {
@@ -260,7 +415,7 @@ namespace HexahedralMesher {
 				size_t end = start + steps;
 				if (end > _verts.size())
 					end = _verts.size();
-				std::shared_ptr<IterVertThread<FUNC>> threadPtr = std::make_shared<IterVertThread<FUNC>>(numCores, i, func, start, end);
+				std::shared_ptr<IterVertThread<FUNC>> threadPtr = std::make_shared<IterVertThread<FUNC>>(numCores, i, func, start, end, false);
 				threads.push_back(threadPtr);
 				start = end;
 			}
@@ -271,4 +426,35 @@ namespace HexahedralMesher {
 		}
 	}
 
+	template <typename FUNC>
+	inline void GridBase::iterateVertList(const std::vector<size_t>& vertIndices, FUNC func, int numCores) const {
+		if (numCores < 2) {
+			for (size_t vertIdx : vertIndices) {
+				if (!func(vertIdx))
+					break;
+			}
+		} else {
+			auto listFunc = [&](size_t i)->bool {
+				return func(vertIndices[i]);
+			};
+			using LIST_FUNC = decltype(listFunc);
+			std::vector<std::shared_ptr<IterVertThread<LIST_FUNC>>> threads;
+			for (int i = 0; i < numCores; i++) {
+				std::shared_ptr<IterVertThread<LIST_FUNC>> threadPtr = std::make_shared<IterVertThread<LIST_FUNC>>(numCores, i, listFunc, 0, vertIndices.size());
+				threads.push_back(threadPtr);
+			}
+
+			for (auto& thread : threads) {
+				thread->getThread().join();
+			}
+		}
+	}
+
+	template <typename FUNC>
+	inline void GridBase::iterateVertsOfType(int clampMask, FUNC func, int numCores) const {
+		std::vector<size_t> vertIndices;
+		getVertsOfType(clampMask, vertIndices);
+		iterateVertList(vertIndices, func, numCores);
+	}
+
 }
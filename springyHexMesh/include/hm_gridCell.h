@@ -53,6 +53,15 @@ namespace HexahedralMesher {
 
 	class GridCell {
 	public:
+		// Bend and compression energy of the cell, valid while the key matches the cell's vertex change numbers.
+		// A negative energy has not been computed for that key yet.
+		struct EnergyCacheRec {
+			size_t _key = stm1;
+			int _bendModel = -1;
+			double _bendEnergy = -1;
+			double _compressionEnergy = -1;
+		};
+
 		static CellVertPos vertPosOf(const Vector3i& vi);
 		static CellVertPos getOppCorner(CellVertPos pos);
 		static FaceNumber getOppFace(FaceNumber face);
@@ -69,6 +78,8 @@ namespace HexahedralMesher {
 		bool readVersion1(std::istream& in);
 
 		bool verify(const GridBase& grid, bool verifyVerts) const;
+		// Checks the cell alone and gives the reason it failed, prints nothing
+		bool verify(const GridBase& grid, std::string& reason) const;
 
 		size_t getId() const;
 		size_t getVertIdx(CellVertPos idx) const;
@@ -99,6 +110,11 @@ namespace HexahedralMesher {
 		size_t calcEdgeLengths(const Grid& grid, std::map<GridEdge, double>& lengths) const;
 
 		double calcVolume(const GridBase& grid) const;
+		// Returns the calling thread's cache entry for the current vertex positions. Returns nullptr on a miss if the entry may not be replaced.
+		EnergyCacheRec* getEnergyCache(const GridBase& grid, bool canReplace) const;
+		// The entry for the primary vertex positions. Only for passes which visit each cell from a single thread.
+		EnergyCacheRec& getPrimaryEnergyCache(const GridBase& grid) const;
+		void clearEnergyCache();
 
 		int getNumClamped(const Grid& grid, int clampMask = -1) const;
 		bool containsPoint(const Grid& grid, const Vector3d& pt) const;
@@ -110,14 +126,19 @@ namespace HexahedralMesher {
 	private:
 		friend class GridBase;
 
+		bool verifyEdgeEnds(CellVertPos p) const;
+
 		void attach(GridBase& grid);
 		void detach(GridBase& grid);
 
-		void updateVertChangeNumbers(const Grid& grid) const;
+		size_t calcVertChangeKey(const GridBase& grid, bool primary) const;
 
 		size_t _id = stm1;
 		size_t _vertIndices[8];
 		double _restEdgeLen[12];
+
+		// One entry per GridVert thread slot, each slot is only touched by its own thread.
+		mutable EnergyCacheRec _energyCache[GRID_VERT_NUM_THREADS + 1];
 	};
 
 	inline size_t GridCell::getId() const {
@@ -142,6 +163,12 @@ namespace HexahedralMesher {
 
 	inline void GridCell::setRestEdgeLength(int i, double val) {
 		_restEdgeLen[i] = val;
+		clearEnergyCache();
+	}
+
+	inline void GridCell::clearEnergyCache() {
+		for (auto& rec : _energyCache)
+			rec = EnergyCacheRec();
 	}
 
 }
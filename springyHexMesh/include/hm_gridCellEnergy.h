@@ -45,24 +45,39 @@ namespace HexahedralMesher {
 				, _pCompress(2.0)
 				, _kBend(1.0)
 				, _pBend(1.0)
+				, _orthoModel(ORTHO_ANGLE)
 			{}
 			inline Params(const Params& src) = default;
 
 			double _kCompress, _pCompress, _kBend, _pBend;
+			OrthoModel _orthoModel;
 		};
 
+		// While a vertex is being trial moved, cached cell energies are read but not replaced.
+		static void setCacheWritesEnabled(bool val);
+
 		GridEnergy(const Grid& grid, const Params& params = Params());
 
 		double calcTotalEnergy(const GridCell& cell) const;
 		double calcCompressionEnergy(const GridCell& cell) const;
 		double calcBendEnergy(const GridCell& cell) const;
 
+		// Kernels on the cell's corner points, ordered by CellVertPos. These evaluate positions which are not in the grid and don't use the cache.
+		double calcTotalEnergy(const GridCell& cell, const Vector3d pts[8]) const;
+		double calcCompressionEnergy(const GridCell& cell, const Vector3d pts[8]) const;
+		double calcBendEnergy(const Vector3d pts[8]) const;
+		double calcTotalEnergy(double orthoEnergy, double volumeEnergy) const;
+
+		double calcMaxCornerAngleError(const GridCell& cell) const;
+
 		double calcTotalEnergy(const GridVert& vert) const;
 		double calcCompressionEnergy(const GridVert& vert) const;
 		double calcBendEnergy(const GridVert& vert) const;
 
 	private:
-		double calcTotalEnergy(double orthoEnergy, double volumeEnergy) const;
+		void getCellPoints(const GridCell& cell, Vector3d pts[8]) const;
+		double calcBendEnergyAngle(const Vector3d pts[8]) const;
+		double calcBendEnergyDotProduct(const Vector3d pts[8]) const;
 
 		const Params _params;
 		const Grid& _grid;
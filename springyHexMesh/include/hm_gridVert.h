@@ -39,12 +39,17 @@ This file is part of the SpringHexMesh Project.
 
 namespace HexahedralMesher {
 
-	template<int NUM_THREADS = 8>
+	template<int NUM_THREADS = GRID_VERT_NUM_THREADS>
 	class GridVertTempl {
 		friend class GridBase;
 		static void setThreadNumber(int threadNumber);
 	public:
 		static int getThreadNumber();
+		static int getThreadIndex();
+		// Changes whenever the primary clamp type of any vertex changes
+		static size_t getClampChangeNumber();
+		// The next change number to be issued, every later change is numbered at or above it
+		static size_t peekNextChangeNumber();
 
 		static void clearHistory();
 		static void writeHistory(const std::string& path);
@@ -53,6 +58,8 @@ namespace HexahedralMesher {
 		GridVertTempl(size_t selfIndex, const Vector3d& pt, int numThreads = 8);
 		GridVertTempl(const GridVertTempl& src) = default;
 		bool verify(const GridBase& grid, bool verifyCells = false) const;
+		// Checks the links and clamp of the vertex alone and gives the reason it failed
+		bool verify(const GridBase& grid, std::string& reason) const;
 		void save(std::ostream& out) const;
 
 		size_t getIndex() const;
@@ -68,8 +75,13 @@ namespace HexahedralMesher {
 		size_t getVertEdgeEndIndices(const Grid& grid, std::set<size_t>& edgeEnds) const;
 
 		void setPoint(const Vector3d& pt);
+		// Puts back a point and the change number it had, so cached cell energies for that position remain valid.
+		void restorePoint(const Vector3d& pt, size_t changeNumber);
 		const Vector3d& getPt() const;
 		Vector3d& getPt();
+		// Primary storage, regardless of the calling thread
+		const Vector3d& getPrimaryPt() const;
+		size_t getPrimaryChangeNumber() const;
 
 		ClampType getClampType() const;
 		const TopolRef& getClamp() const;
@@ -97,6 +109,8 @@ namespace HexahedralMesher {
 		friend class Grid;
 
 		bool readVersion1(std::istream& in);
+		static size_t nextChangeNumber();
+		static void clampTypeChanged();
 
 		size_t _selfIndex;
 		// Index 0 is 'non-threaded' 1 - numThreads + 1 are the thread copies
@@ -106,7 +120,8 @@ namespace HexahedralMesher {
 		TopolRef _clampTopol[NUM_THREADS + 1];
 		TopolRef _stashClamp;
 
-		size_t _changeNumber = 0;
+		// Change numbers are unique across all verts and all threads, so a set of them identifies a set of positions.
+		size_t _changeNumber[NUM_THREADS + 1];
 		std::vector<size_t> _cellIndices;
 	};
 
@@ -116,9 +131,10 @@ namespace HexahedralMesher {
 	template<int NUM_THREADS>
 	inline GridVertTempl<NUM_THREADS>::GridVertTempl(size_t selfIndex, int numThreads)
 		: _selfIndex(selfIndex)
-		, _changeNumber(0)
 	{
 		_pt[0] = Vector3d(DBL_MAX, DBL_MAX, DBL_MAX);
+		for (auto& cn : _changeNumber)
+			cn = nextChangeNumber();
 	}
 
 	template<int NUM_THREADS>
@@ -126,7 +142,8 @@ namespace HexahedralMesher {
 		: _selfIndex(selfIndex)
 	{
 		_pt[0] = pt;
-		_changeNumber++;
+		for (auto& cn : _changeNumber)
+			cn = nextChangeNumber();
 	}
 
 	template<int NUM_THREADS>
@@ -135,8 +152,13 @@ namespace HexahedralMesher {
 	}
 
 	template<int NUM_THREADS>
-	inline size_t GridVertTempl<NUM_THREADS>::getChangeNumber() const {
-		return _changeNumber;
+	inline const Vector3d& GridVertTempl<NUM_THREADS>::getPrimaryPt() const {
+		return _pt[0];
+	}
+
+	template<int NUM_THREADS>
+	inline size_t GridVertTempl<NUM_THREADS>::getPrimaryChangeNumber() const {
+		return _changeNumber[0];
 	}
 
 	template<int NUM_THREADS>
@@ -185,5 +207,5 @@ namespace HexahedralMesher {
 		_stashClamp = clamp;
 	}
 
-	using GridVert = GridVertTempl<8>;
+	using GridVert = GridVertTempl<GRID_VERT_NUM_THREADS>;
 }
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <vector>
+
+#include <hm_types.h>
+#include <hm_forwardDeclarations.h>
+
+namespace HexahedralMesher {
+
+	/*
+	Cheap pre-smoother for the energy minimization. Each pass moves every movable vertex part way toward the average of its
+	edge neighbors, projected onto its clamp, then repairs the dependent vertices.
+	The passes are Jacobi style, the new points are computed in parallel from the primary points and then applied.
+	*/
+	class CLaplacianSmoother {
+	public:
+		CLaplacianSmoother(Grid& grid, int clampMask, int numThreads);
+
+		// Returns the max move of the last pass
+		double smooth(int numPasses);
+
+	private:
+		// The move is limited to maxMove before it's projected, so curved clamps are followed exactly. clampIdx is the new
+		// polyline index of an edge clamp or model triangle of a surface clamp, SIZE_MAX for the other clamps.
+		Vector3d projectToClamp(size_t vertIdx, const Vector3d& delta, double maxMove, size_t& clampIdx) const;
+
+		Grid& _grid;
+		int _clampMask;
+		int _numThreads;
+		double _relaxation = 0.5;
+
+		// Edge neighbors of vertex i are _neighbors[_neighborStart[i]] to _neighbors[_neighborStart[i + 1] - 1]
+		std::vector<size_t> _neighborStart, _neighbors;
+		std::vector<Vector3d> _newPts;
+		std::vector<size_t> _newClampIdx;
+	};
+
+}
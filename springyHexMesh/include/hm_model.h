@@ -37,6 +37,8 @@ This file is part of the SpringHexMesh Project.
 #include <tm_spatialSearch.h>
 #include <triMesh.h>
 #include <tm_polyLine.h>
+#include <hm_polylineArcLength.h>
+#include <hm_triangleBVH.h>
 
 namespace HexahedralMesher {
 
@@ -53,6 +55,14 @@ namespace HexahedralMesher {
 		inline bool polylineExists(size_t idx) const {
 			return idx < _polyLines.size();
 		}
+		// Built once when the polylines are created or read, shared by all the threads
+		inline const PolylineArcLength& getPolylineArcLength(size_t idx) const {
+			return _polylineArcLengths[idx];
+		}
+		// Built with the arc lengths, used to project CLAMP_TRI vertices onto the surface
+		inline const CTriangleBVH& getTriangleBVH() const {
+			return _triangleBVH;
+		}
 
 		const double _sinSharpAngle;
 		SearchTree _sharpEdgeTree;
@@ -63,6 +73,10 @@ namespace HexahedralMesher {
 		void findSharpEdges(std::vector<size_t>& sharps);
 		void createPolylines(std::vector<size_t>& sharps);
 		void createCuspsAndSplitPolylines();
+		void createPolylineArcLengths();
+
+		std::vector<PolylineArcLength> _polylineArcLengths;
+		CTriangleBVH _triangleBVH;
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <vector>
+#include <map>
+
+#include <hm_types.h>
+#include <hm_forwardDeclarations.h>
+
+namespace HexahedralMesher {
+
+	/*
+	Coarse level of a two level V-cycle, built from the grid's split hierarchy.
+	The coarse vertices are the corners of the split parents whose children are all still in the grid.
+	A coarse move is prolongated to the children's vertices by trilinear interpolation over the parent cell,
+	and is scored with the fine cells' energy, so no coarse energy model is needed.
+	*/
+	class CMultilevel {
+	public:
+		CMultilevel(Grid& grid);
+
+		size_t numCoarseVerts() const;
+
+		// One sweep over the coarse vertices, in order. Returns the max move, avgMove is the average.
+		double coarseSweep(double& avgMove);
+
+	private:
+		struct Prolongation {
+			size_t _vertIdx;
+			std::map<size_t, double> _fineWeights;
+			std::vector<size_t> _cells;
+		};
+
+		void build();
+		double minimizeCoarseVertex(const Prolongation& prolong);
+		double calcEnergy(const Prolongation& prolong, const Vector3d& delta) const;
+		Vector3d projectToClamp(size_t vertIdx, const Vector3d& delta) const;
+
+		Grid& _grid;
+		std::vector<Prolongation> _prolongations;
+	};
+
+	inline size_t CMultilevel::numCoarseVerts() const {
+		return _prolongations.size();
+	}
+
+}
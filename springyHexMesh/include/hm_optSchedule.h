@@ -0,0 +1,138 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <hm_types.h>
+
+namespace HexahedralMesher {
+
+	/*
+	Budgets and settings of the minimization stages of the CMesher pipeline, optionally read from a text file.
+
+	Each stage has a budget of sweeps and seconds. A stage which converges before using its budget returns the rest to a pool,
+	later stages may borrow from the pool, up to their borrow fraction of their own budget. Energy parameters are continued,
+	the stage runs in continuationSteps parts with kCompress and kBend moved from their start to their end values.
+
+	File format, one keyword per line and # starts a comment. Stages not in the file keep their defaults.
+	The solver, tolerance and energy weight keys are optional, a stage which doesn't set them runs with the mesher's ParamsRec values.
+
+		stage preFit
+			meshSolver sweep			(sweep, lbfgs, fire or priority)
+			vertexSolver steepest		(steepest, newton or reduced)
+			sweeps 75
+			seconds 0					(0 is no limit)
+			moveTol 0.001
+			energyTol 1e-4
+			kCompress 0.001 0.001		(start end)
+			kBend 1 1					(start end)
+			continuationSteps 1
+			borrow 1
+		end
+	*/
+	class COptSchedule {
+	public:
+		// Bits of Stage::_overrides, the settings a stage applies over the mesher's ParamsRec
+		enum Override {
+			OVR_MESH_SOLVER = 1 << 0,
+			OVR_VERTEX_SOLVER = 1 << 1,
+			OVR_MOVE_TOL = 1 << 2,
+			OVR_ENERGY_TOL = 1 << 3,
+			OVR_K_COMPRESS = 1 << 4,
+			OVR_K_BEND = 1 << 5,
+		};
+
+		struct Stage {
+			std::string _name;
+			int _overrides = 0;	// Override bits of the fields below which were set
+			MeshSolver _meshSolver = MS_VERTEX_SWEEP;
+			VertexSolver _vertexSolver = VS_STEEPEST_DESCENT;
+			int _maxSweeps = 50;
+			double _maxSeconds = 0;
+			double _convergeMoveTol = 0.001;	// Fraction of maxEdgeLength
+			double _convergeEnergyTol = 1.0e-4;
+			double _kCompress[2] = { 0.001, 0.001 };
+			double _kBend[2] = { 1.0, 1.0 };
+			int _continuationSteps = 1;
+			double _borrowFraction = 1.0;	// Of _maxSweeps and _maxSeconds, 0 disables borrowing
+		};
+
+		// Measured by the last run of a stage
+		struct StageResult {
+			int _sweepsAllocated = 0;
+			int _sweepsUsed = 0;
+			double _secondsAllocated = 0;
+			double _secondsUsed = 0;
+			bool _converged = false;
+		};
+
+		// The defaults are the pipeline's original step counts, preFit, polylineFit, aligned and divide
+		COptSchedule();
+
+		bool read(const std::string& path);
+		bool read(std::istream& in);
+		void save(std::ostream& out) const;
+
+		// Adds the stage or replaces the one with the same name
+		void setStage(const Stage& stage);
+		// Throws if there's no stage with the name
+		const Stage& getStage(const std::string& name) const;
+		size_t numStages() const;
+
+		// The stage's budget plus what it may borrow from the pool. The borrowed amount is taken from the pool.
+		void allocate(const std::string& name, int& sweeps, double& seconds);
+		// Returns the unused budget of a converged stage to the pool
+		void reportResult(const std::string& name, const StageResult& result);
+		void resetPool();
+
+		void dumpResults(std::ostream& out) const;
+
+		static const char* getMeshSolverStr(MeshSolver solver);
+		static const char* getVertexSolverStr(VertexSolver solver);
+
+	private:
+		size_t findStage(const std::string& name) const;
+
+		std::vector<Stage> _stages;
+		std::vector<StageResult> _results;
+		int _sweepPool = 0;
+		double _secondsPool = 0;
+	};
+
+	inline size_t COptSchedule::numStages() const {
+		return _stages.size();
+	}
+
+}
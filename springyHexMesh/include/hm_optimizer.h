@@ -34,22 +34,39 @@ This file is part of the SpringHexMesh Project.
 
 namespace HexahedralMesher {
 
+	// Values already evaluated around the current point, so the next stage doesn't evaluate them again. NaN where unknown.
+	struct KnownValues {
+		double _minus = NAN;	// At -dt along the search direction
+		double _center = NAN;
+		double _plus = NAN;		// At +dt along the search direction
+
+		void clear() {
+			_minus = _center = _plus = NAN;
+		}
+	};
+
+	/*
+	Backtracking line search along a descent direction.
+	The first trial is the parabolic fit through the values at -dt, 0 and +dt. A trial is accepted if it satisfies the Armijo sufficient decrease condition,
+	otherwise the step is reduced by safeguarded quadratic, then cubic, interpolation. Evaluations per search are bounded by maxEvaluations.
+	*/
 	template<class VECTOR_TYPE>
-	class SteepestAcent {
+	class LineSearch {
 	public:
-		SteepestAcent(double minVal, double differential = 1.0e-8)
-			: _dt(differential)
-			, _minVal(minVal)
+		LineSearch(double dt, double sufficientDecrease = 1.0e-4, int maxEvaluations = 4)
+			: _dt(dt)
+			, _c1(sufficientDecrease)
+			, _maxEvaluations(maxEvaluations)
 		{}
 
-		template<typename VAL_FUNC>
-		static double calcMoveDist (VECTOR_TYPE& curValue, double dt, const Vector3d& gradient, VAL_FUNC calVal) {
-			double val1 = calVal(curValue);
+		// Parabolic fit through the values at -dt, 0 and +dt along the direction
+		static double calcMoveDist(const double vals[3], double dt) {
+			double val1 = vals[1];
 			if (fabs(val1) < minNormalizeDivisor)
 				return 0;
 
-			double val0 = calVal(curValue - dt * gradient) - val1;
-			double val2 = calVal(curValue + dt * gradient) - val1;
+			double val0 = vals[0] - val1;
+			double val2 = vals[2] - val1;
 
 			double a = (val2 + val0) / (2 * dt * dt);
 			if (fabs(a) < minNormalizeDivisor)
@@ -59,33 +76,141 @@ namespace HexahedralMesher {
 			double moveDist = -b / (2 * a);
 
 			if (std::isnan(moveDist) || std::isinf(moveDist)) {
-				calVal(curValue);
 				throw "Bad moveDist";
 			}
 			return moveDist;
-		};
+		}
+
+		/*
+		vals are the values at -dt, 0 and +dt along dir, which must descend.
+		calVals(const VECTOR_TYPE pts[], int numPts, double vals[]) evaluates the trial points.
+		Returns the accepted step, 0 if none was found, and its value in newVal.
+		*/
+		template<typename VALS_FUNC>
+		double search(const VECTOR_TYPE& x, const VECTOR_TYPE& dir, const double vals[3], double maxStep, VALS_FUNC calVals, double& newVal) {
+			const double f0 = vals[1];
+			const double slope = (vals[2] - vals[0]) / (2 * _dt);
+			newVal = f0;
+			if (slope >= 0 || maxStep <= 0)
+				return 0;
+
+			double t = calcMoveDist(vals, _dt);
+			if (t <= 0 || t > maxStep) // Concave or beyond the limit
+				t = maxStep;
+
+			double prevT = 0, prevVal = f0;
+			for (int i = 0; i < _maxEvaluations && t > OPTIMIZER_TOL; i++) {
+				VECTOR_TYPE pt = x + t * dir;
+				double val;
+				calVals(&pt, 1, &val);
+				_numEvaluations++;
+
+				if (val <= f0 + _c1 * t * slope) {
+					newVal = val;
+					return t;
+				}
+
+				double nextT = (i == 0) ? interpolateQuadratic(f0, slope, t, val) : interpolateCubic(f0, slope, t, val, prevT, prevVal);
+				prevT = t;
+				prevVal = val;
+				t = safeguard(nextT, t);
+			}
+
+			return 0;
+		}
+
+		size_t getNumEvaluations() const {
+			return _numEvaluations;
+		}
+
+	private:
+		// Minimum of the parabola through f(0), f'(0) and f(t)
+		static double interpolateQuadratic(double f0, double slope, double t, double ft) {
+			double denom = 2 * (ft - f0 - slope * t);
+			if (denom <= minNormalizeDivisor)
+				return -1;
+			return -slope * t * t / denom;
+		}
+
+		// Minimum of the cubic through f(0), f'(0), f(t1) and f(t0)
+		static double interpolateCubic(double f0, double slope, double t1, double f1, double t0, double fPrev) {
+			double d1 = f1 - f0 - slope * t1;
+			double d0 = fPrev - f0 - slope * t0;
+			double denom = t0 * t0 * t1 * t1 * (t1 - t0);
+			if (fabs(denom) < minNormalizeDivisor)
+				return interpolateQuadratic(f0, slope, t1, f1);
+
+			double a = (t0 * t0 * d1 - t1 * t1 * d0) / denom;
+			double b = (-t0 * t0 * t0 * d1 + t1 * t1 * t1 * d0) / denom;
+			if (fabs(a) < minNormalizeDivisor)
+				return -slope / (2 * b);
 
-		template<typename VAL_FUNC, typename GRAD_FUNC, typename LOG_FUNC>
-		double run(VECTOR_TYPE& curValue, int maxSteps, double maxChange, VAL_FUNC calVal, GRAD_FUNC calGrad, LOG_FUNC log) {
+			double disc = b * b - 3 * a * slope;
+			if (disc < 0)
+				return -1;
+			return (-b + sqrt(disc)) / (3 * a);
+		}
+
+		// Keeps the reduced step in [0.1, 0.5] of the rejected step
+		static double safeguard(double nextT, double t) {
+			if (std::isnan(nextT) || nextT < 0.1 * t)
+				return 0.1 * t;
+			if (nextT > 0.5 * t)
+				return 0.5 * t;
+			return nextT;
+		}
+
+		double _dt, _c1;
+		int _maxEvaluations;
+		size_t _numEvaluations = 0;
+	};
+
+	template<class VECTOR_TYPE>
+	class SteepestAcent {
+	public:
+		SteepestAcent(double minVal, double differential = 1.0e-8)
+			: _dt(differential)
+			, _minVal(minVal)
+		{}
+
+		/*
+		calGrad(double dt, VECTOR_TYPE& gradient, KnownValues& known) returns the distance the gradient is valid for, DBL_MAX if it's unlimited and 0 to stop.
+		It may fill in the values it evaluated at the current point. An unlimited gradient's sign doesn't matter, the search turns it downhill.
+		*/
+		template<typename VALS_FUNC, typename GRAD_FUNC, typename LOG_FUNC>
+		double run(VECTOR_TYPE& curValue, int maxSteps, double maxChange, VALS_FUNC calVals, GRAD_FUNC calGrad, LOG_FUNC log) {
 			VECTOR_TYPE startPoint = curValue;
 			double moveDist = DBL_MAX;
 			double maxStep = 0.2 * maxChange;
+			LineSearch<VECTOR_TYPE> lineSearch(_dt);
+			KnownValues known;
 			for (int count = 0; count < maxSteps && moveDist > OPTIMIZER_TOL; count++) {
 				VECTOR_TYPE gradient;
-				double maxDist = calGrad(_dt, gradient);
+				double maxDist = calGrad(_dt, gradient, known);
 				if (maxDist == 0) {
 					// This only returned when calGrad couldn't find an increasing direction
 					break;
 				}
 
-				moveDist = calcMoveDist(curValue, _dt, gradient, calVal);
-				if (moveDist > maxStep)
-					moveDist = maxStep;
+				double vals[3];
+				evaluateStencil(curValue, gradient, calVals, known, vals);
+				if (maxDist == DBL_MAX && vals[2] > vals[0]) {
+					gradient = -gradient;
+					std::swap(vals[0], vals[2]);
+				}
+
+				double limit = std::min(maxStep, maxDist);
+				double newVal;
+				moveDist = lineSearch.search(curValue, gradient, vals, limit, calVals, newVal);
+				known.clear();
+				if (moveDist == 0)
+					break;
 
-				if (moveDist > maxDist) {
+				if (moveDist >= maxDist) {
 					// This is the faceted move limit, we've run onto a dicontinuity like a vertext or
 					// edge on the model. Let calGrad test if we can progress.
-					curValue = curValue + maxDist * gradient;
+					curValue = curValue + moveDist * gradient;
+					known._center = newVal;
 					continue;
 				}
 
@@ -94,15 +219,294 @@ namespace HexahedralMesher {
 				if (totalDist > maxChange) {
 					break;
 				}
-				curValue = curValue + moveDist * gradient;
+				curValue = nextPoint;
+				known._center = newVal;
 				log(count, moveDist);
 			}
 
-			moveDist = (curValue - startPoint).norm();
 			return (curValue - startPoint).norm();
 		}
 
 	private:
+		// Values at -dt, 0 and +dt along the gradient, only the unknown ones are evaluated
+		template<typename VALS_FUNC>
+		void evaluateStencil(const VECTOR_TYPE& curValue, const VECTOR_TYPE& gradient, VALS_FUNC calVals, const KnownValues& known, double vals[3]) {
+			const double knownVals[3] = { known._minus, known._center, known._plus };
+			VECTOR_TYPE pts[3];
+			int idx[3], numPts = 0;
+			for (int i = 0; i < 3; i++) {
+				vals[i] = knownVals[i];
+				if (std::isnan(vals[i])) {
+					idx[numPts] = i;
+					pts[numPts++] = curValue + (i - 1) * _dt * gradient;
+				}
+			}
+
+			if (numPts > 0) {
+				double newVals[3];
+				calVals(pts, numPts, newVals);
+				for (int i = 0; i < numPts; i++)
+					vals[idx[i]] = newVals[i];
+			}
+		}
+
 		double _dt, _minVal;
 	};
+
+	/*
+	Local Newton solver with a trust region, for a vertex moving in DIM dimensions.
+	DIM is 3 for a free vertex, 2 on a plane and 1 on a line, the caller maps local coordinates to points.
+	The gradient and Hessian are fit with central differences from one batched stencil of 1 + 2 * DIM + 2 * DIM * (DIM - 1) samples.
+	*/
+	template<int DIM>
+	class NewtonTrustRegion {
+	public:
+		using Vec = Eigen::Matrix<double, DIM, 1>;
+		using Mat = Eigen::Matrix<double, DIM, DIM>;
+		static const int NUM_STENCIL_PTS = 1 + 2 * DIM + 2 * DIM * (DIM - 1);
+
+		NewtonTrustRegion(double minVal, double stencilSize, double radius, double maxRadius)
+			: _minVal(minVal)
+			, _h(stencilSize)
+			, _radius(radius)
+			, _maxRadius(maxRadius)
+		{}
+
+		// Samples around u, center first, then -h and +h on each axis, then ++, +-, -+, -- for each axis pair
+		void makeStencil(const Vec& u, Vec pts[NUM_STENCIL_PTS]) const {
+			int n = 0;
+			pts[n++] = u;
+			for (int i = 0; i < DIM; i++) {
+				pts[n++] = u - _h * Vec::Unit(i);
+				pts[n++] = u + _h * Vec::Unit(i);
+			}
+			for (int i = 0; i < DIM; i++) {
+				for (int j = i + 1; j < DIM; j++) {
+					Vec dI = _h * Vec::Unit(i), dJ = _h * Vec::Unit(j);
+					pts[n++] = u + dI + dJ;
+					pts[n++] = u + dI - dJ;
+					pts[n++] = u - dI + dJ;
+					pts[n++] = u - dI - dJ;
+				}
+			}
+		}
+
+		void fitStencil(const double vals[NUM_STENCIL_PTS], Vec& grad, Mat& hessian) const {
+			const double f0 = vals[0];
+			const double h2 = _h * _h;
+			int n = 1;
+			for (int i = 0; i < DIM; i++) {
+				double fM = vals[n++], fP = vals[n++];
+				grad[i] = (fP - fM) / (2 * _h);
+				hessian(i, i) = (fP - 2 * f0 + fM) / h2;
+			}
+			for (int i = 0; i < DIM; i++) {
+				for (int j = i + 1; j < DIM; j++) {
+					double fPP = vals[n++], fPM = vals[n++], fMP = vals[n++], fMM = vals[n++];
+					hessian(i, j) = hessian(j, i) = (fPP - fPM - fMP + fMM) / (4 * h2);
+				}
+			}
+		}
+
+		/*
+		Newton step with the Hessian's eigenvalues replaced by their magnitudes, so the step always descends even where the energy isn't convex.
+		Falls back to steepest descent if the energy is flat.
+		*/
+		Vec calcStep(const Vec& grad, const Mat& hessian) const {
+			Eigen::SelfAdjointEigenSolver<Mat> solver(hessian);
+			Vec eigenValues = solver.eigenvalues().cwiseAbs();
+			double maxEigenValue = eigenValues.maxCoeff();
+			if (maxEigenValue < minNormalizeDivisor)
+				return -_radius * grad.normalized();
+
+			double minEigenValue = 1.0e-6 * maxEigenValue;
+			for (int i = 0; i < DIM; i++) {
+				if (eigenValues[i] < minEigenValue)
+					eigenValues[i] = minEigenValue;
+			}
+			const Mat& vecs = solver.eigenvectors();
+			Vec result = -vecs * (vecs.transpose() * grad).cwiseQuotient(eigenValues);
+			return result;
+		}
+
+		/*
+		calVals(const Vec pts[], int numPts, double vals[]) evaluates all the samples in one call.
+		The step is kept inside [lower, upper] and the total move inside maxChange.
+		Returns the distance moved.
+		*/
+		template<typename VALS_FUNC, typename LOG_FUNC>
+		double run(Vec& u, int maxSteps, double maxChange, const Vec& lower, const Vec& upper, VALS_FUNC calVals, LOG_FUNC log) {
+			const Vec startPoint = u;
+			Vec pts[NUM_STENCIL_PTS];
+			double vals[NUM_STENCIL_PTS];
+			Vec grad, newtonStep;
+			Mat hessian;
+			// A rejected step only shrinks the radius, u hasn't moved so the fit is still good
+			bool needFit = true;
+			for (int count = 0; count < maxSteps; count++) {
+				if (needFit) {
+					makeStencil(u, pts);
+					calVals(pts, NUM_STENCIL_PTS, vals);
+					if (vals[0] < _minVal)
+						break;
+
+					fitStencil(vals, grad, hessian);
+					if (grad.norm() < minNormalizeDivisor)
+						break;
+
+					newtonStep = calcStep(grad, hessian);
+				}
+
+				Vec step = newtonStep;
+				double len = step.norm();
+				if (len > _radius)
+					step *= _radius / len;
+
+				double scale = 1;
+				for (int i = 0; i < DIM; i++) {
+					if (u[i] + step[i] > upper[i])
+						scale = std::min(scale, (upper[i] - u[i]) / step[i]);
+					else if (u[i] + step[i] < lower[i])
+						scale = std::min(scale, (lower[i] - u[i]) / step[i]);
+				}
+				step *= scale;
+
+				len = step.norm();
+				if (len < OPTIMIZER_TOL)
+					break;
+
+				Vec trial = u + step;
+				if ((trial - startPoint).norm() > maxChange)
+					break;
+
+				double trialVal;
+				calVals(&trial, 1, &trialVal);
+				double actual = trialVal - vals[0];
+				double predicted = grad.dot(step) + 0.5 * step.dot(hessian * step);
+				if (actual < 0) {
+					u = trial;
+					needFit = true;
+					log(count, len);
+
+					double ratio = predicted < 0 ? actual / predicted : 0;
+					if (ratio > 0.75 && len > 0.99 * _radius)
+						_radius = std::min(2 * _radius, _maxRadius);
+					else if (ratio < 0.25)
+						_radius *= 0.5;
+				} else {
+					_radius = 0.25 * len;
+					if (_radius < OPTIMIZER_TOL)
+						break;
+					needFit = false;
+				}
+			}
+
+			return (u - startPoint).norm();
+		}
+
+	private:
+		double _minVal, _h, _radius, _maxRadius;
+	};
+
+	/*
+	Bounded 1D minimizer for a vertex moving along a line or curve.
+	Brackets the minimum by stepping downhill with golden ratio growth, then narrows the bracket by golden section.
+	calVals(const double u[], int numPts, double vals[]) evaluates the samples, the first bracketing pair is evaluated in one call.
+	*/
+	class GoldenSection {
+	public:
+		GoldenSection(double tol, int maxEvaluations = 20)
+			: _tol(tol)
+			, _maxEvaluations(maxEvaluations)
+		{}
+
+		// Returns the best u in [lower, upper], u0 must be inside. Stops without moving if the value at u0 is below minVal.
+		template<typename VALS_FUNC>
+		double run(double u0, double step, double lower, double upper, double minVal, VALS_FUNC calVals) {
+			const double gold = 0.5 * (sqrt(5.0) - 1); // 0.618...
+			_numEvaluations = 0;
+
+			auto clampU = [&](double u)->double {
+				return std::min(upper, std::max(lower, u));
+			};
+
+			double us[3] = { clampU(u0 - step), u0, clampU(u0 + step) };
+			double vals[3];
+			calVals(us, 3, vals);
+			_numEvaluations += 3;
+			if (vals[1] < minVal)
+				return u0;
+
+			// [lo, hi] brackets the minimum, b is the best sample inside it
+			double lo, hi, b, fb;
+			if (vals[1] <= vals[0] && vals[1] <= vals[2]) {
+				lo = us[0];
+				hi = us[2];
+				b = u0;
+				fb = vals[1];
+			} else {
+				// Walk downhill, growing the step, until the value rises or the bound is hit
+				bool down = vals[0] < vals[2];
+				const double bound = down ? lower : upper;
+				double a = u0;
+				b = down ? us[0] : us[2];
+				fb = down ? vals[0] : vals[2];
+				while (true) {
+					if (b == bound || _numEvaluations >= _maxEvaluations)
+						return b;
+
+					double c = clampU(b + (b - a) / gold), fc;
+					calVals(&c, 1, &fc);
+					_numEvaluations++;
+					if (fc >= fb) {
+						lo = std::min(a, c);
+						hi = std::max(a, c);
+						break;
+					}
+					a = b;
+					b = c;
+					fb = fc;
+				}
+			}
+
+			// Golden section
+			double x1 = hi - gold * (hi - lo), x2 = lo + gold * (hi - lo);
+			double f1, f2;
+			double xs[2] = { x1, x2 }, fs[2];
+			calVals(xs, 2, fs);
+			_numEvaluations += 2;
+			f1 = fs[0];
+			f2 = fs[1];
+			while (hi - lo > _tol && _numEvaluations < _maxEvaluations) {
+				if (f1 < f2) {
+					hi = x2;
+					x2 = x1;
+					f2 = f1;
+					x1 = hi - gold * (hi - lo);
+					calVals(&x1, 1, &f1);
+				} else {
+					lo = x1;
+					x1 = x2;
+					f1 = f2;
+					x2 = lo + gold * (hi - lo);
+					calVals(&x2, 1, &f2);
+				}
+				_numEvaluations++;
+			}
+
+			// Never return something worse than the best bracketing sample
+			double best = f1 < f2 ? x1 : x2;
+			double fBest = std::min(f1, f2);
+			return fBest < fb ? best : b;
+		}
+
+		int getNumEvaluations() const {
+			return _numEvaluations;
+		}
+
+	private:
+		double _tol;
+		int _maxEvaluations;
+		int _numEvaluations = 0;
+	};
 }
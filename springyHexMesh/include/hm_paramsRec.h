@@ -50,6 +50,22 @@ namespace HexahedralMesher {
 		double minGapSize = 0.01;
 		double maxEdgeLength = 1.0;
 		double sharpAngleDeg = 20.0; // Limit delta angle between perpendiculars/normals
+		OrthoModel orthoModel = ORTHO_ANGLE;
+		VertexSolver vertexSolver = VS_STEEPEST_DESCENT;
+		MeshSolver meshSolver = MS_VERTEX_SWEEP;
+		bool activeSet = false; // Only minimize vertices whose neighborhood changed in the last sweep
+		int preSmoothPasses = 0; // Constrained Laplacian passes before minimizing, 0 disables
+		int coarseSweeps = 0; // Coarse level sweeps after each vertex sweep, 0 disables the multilevel V-cycle
+		double priorityMaxSeconds = 0; // Wall clock budget for MS_PRIORITY, 0 is no limit
+		double sweepMaxSeconds = 0; // Wall clock budget for MS_VERTEX_SWEEP, 0 is no limit
+		size_t priorityMaxRelaxations = 0; // Vertex relaxation budget for MS_PRIORITY, 0 uses steps * numVerts
+		double convergeMoveTol = 0.001; // Stop sweeping when the max move is below this fraction of maxEdgeLength
+		double convergeEnergyTol = 1.0e-4; // Stop sweeping when the total energy drops less than this fraction over the window
+		int convergeWindow = 5; // Sweeps
+		double kCompress = 0.001; // Energy weights, the schedule continues them between stages
+		double kBend = 1.0;
+		ValidationTier validationTier = VT_FULL; // Checks run by addCell, deleteCell and setVertPos
+		double validationSampleRate = 0.01; // Fraction of mutations checked by VT_SAMPLED
 		CBoundingBox3Dd bounds;
 	};
 
@@ -0,0 +1,96 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <vector>
+
+#include <hm_types.h>
+#include <hm_forwardDeclarations.h>
+#include <triMesh.h>
+
+namespace HexahedralMesher {
+
+	/*
+	Arc length parameterization of a model polyline, used to move edge clamped vertices along the whole polyline.
+	Closest point queries use a bounding volume hierarchy over the segments. A query can start from a hint segment, usually the clamp's
+	polyline index, which gives a tight bound so the search opens few nodes besides the hint's.
+	*/
+	class PolylineArcLength {
+	public:
+		PolylineArcLength(const TriMesh::CMesh& mesh, const TriMesh::CPolyLine& pl);
+
+		double getLength() const;
+		size_t numSegments() const;
+		const LineSegment& getSegment(size_t idx) const;
+
+		double findArcLength(const Vector3d& pt, size_t hintIdx = SIZE_MAX) const;
+		size_t findSegmentIndex(double s) const;
+		Vector3d calcPoint(double s) const;
+		Vector3d calcDir(double s) const;
+
+		/*
+		Same outputs as TriMesh::CPolyLine::findClosestPointOnPolyline. segIdx is the closest segment, dist the distance to it and
+		t the parameter on it. t is only outside [0, 1] off the ends of the polyline. Returns true if the point is on the polyline.
+		*/
+		bool findClosestPoint(const Vector3d& pt, size_t hintIdx, size_t& segIdx, double& dist, double& t) const;
+
+	private:
+		struct Node {
+			Vector3d _min, _max;
+			// Children for an interior node, the range in _segOrder for a leaf
+			size_t _left, _right;
+			bool _leaf;
+		};
+
+		size_t buildNode(size_t begin, size_t end);
+		double calcSegmentDist(size_t segIdx, const Vector3d& pt, double& t) const;
+		void searchNode(size_t nodeIdx, const Vector3d& pt, size_t& bestIdx, double& bestDist, double& bestT) const;
+
+		std::vector<LineSegment> _segs;
+		std::vector<double> _segStart;
+		std::vector<Node> _nodes;
+		std::vector<size_t> _segOrder;
+	};
+
+	inline double PolylineArcLength::getLength() const {
+		return _segStart.back();
+	}
+
+	inline size_t PolylineArcLength::numSegments() const {
+		return _segs.size();
+	}
+
+	inline const LineSegment& PolylineArcLength::getSegment(size_t idx) const {
+		return _segs[idx];
+	}
+
+}
@@ -34,7 +34,7 @@ This file is part of the SpringHexMesh Project.
 
 namespace HexahedralMesher {
 
-	const CellVertPos gFaceIdxLUT[6][4] = {
+	constexpr CellVertPos gFaceIdxLUT[6][4] = {
 		{LWR_FNT_LFT, LWR_BCK_LFT, LWR_BCK_RGT, LWR_FNT_RGT}, // bottom 0 0 0
 		{UPR_FNT_LFT, UPR_FNT_RGT, UPR_BCK_RGT, UPR_BCK_LFT}, // top    0 0 1
 
@@ -45,7 +45,7 @@ namespace HexahedralMesher {
 		{LWR_FNT_RGT, LWR_BCK_RGT, UPR_BCK_RGT, UPR_FNT_RGT}, // right
 	};
 
-	const int gVertEdgePosLUT[6][4] = {
+	constexpr int gVertEdgePosLUT[6][4] = {
 		{ // bottom
 			Y_POS, X_POS, Y_NEG, X_NEG,
 		},
@@ -66,7 +66,7 @@ namespace HexahedralMesher {
 		},
 	};
 
-	const CellVertPos gPosEdgePosLT[8][6] = {
+	constexpr CellVertPos gPosEdgePosLT[8][6] = {
 		{ // LWR_FNT_LFT
 			LWR_FNT_RGT, // X_POS,
 			LWR_BCK_LFT, // Y_POS,
@@ -134,7 +134,7 @@ namespace HexahedralMesher {
 		},
 	};
 
-	const CellVertPos gEdgeVerts[12][2] = {
+	constexpr CellVertPos gEdgeVerts[12][2] = {
 		{LWR_FNT_LFT, LWR_FNT_RGT}, // Front face
 		{LWR_FNT_RGT, UPR_FNT_RGT},
 		{UPR_FNT_RGT, UPR_FNT_LFT},
@@ -151,7 +151,7 @@ namespace HexahedralMesher {
 		{UPR_FNT_LFT, UPR_BCK_LFT},
 	};
 
-	const FaceNumber gPosFaceNumberLUT[8][3] = {
+	constexpr FaceNumber gPosFaceNumberLUT[8][3] = {
 		{ // LWR_FNT_LFT
 			BOTTOM, LEFT, FRONT,
 		},
@@ -179,7 +179,7 @@ namespace HexahedralMesher {
 		},
 	};
 		
-	const CellVertPos gOppCornerLUT[] = {
+	constexpr CellVertPos gOppCornerLUT[] = {
 		UPR_BCK_RGT,
 		UPR_BCK_LFT,
 		UPR_FNT_RGT,
@@ -190,7 +190,7 @@ namespace HexahedralMesher {
 		LWR_FNT_LFT,
 	};
 
-	const FaceNumber gOppFaceLUT[] = {
+	constexpr FaceNumber gOppFaceLUT[] = {
 		TOP,
 		BOTTOM,
 		BACK,
@@ -199,4 +199,78 @@ namespace HexahedralMesher {
 		LEFT,
 	};
 
+	// Triangulation of each face, ordered as gFaceIdxLUT. Triangle 0 is corners 0, 1, 2 and triangle 1 is corners 0, 2, 3
+	struct FaceTriPosTable {
+		CellVertPos _pos[6][2][3];
+
+		constexpr const CellVertPos(&operator[](size_t face) const)[2][3] {
+			return _pos[face];
+		}
+	};
+
+	// Derived from gFaceIdxLUT so the two tables can't disagree
+	constexpr FaceTriPosTable makeFaceTriPosLUT() {
+		FaceTriPosTable result = {};
+		for (int face = 0; face < 6; face++) {
+			for (int tri = 0; tri < 2; tri++) {
+				result._pos[face][tri][0] = gFaceIdxLUT[face][0];
+				result._pos[face][tri][1] = gFaceIdxLUT[face][tri + 1];
+				result._pos[face][tri][2] = gFaceIdxLUT[face][tri + 2];
+			}
+		}
+		return result;
+	}
+
+	constexpr FaceTriPosTable gFaceTriPosLUT = makeFaceTriPosLUT();
+
+	struct SignedVector {
+		double sign;
+		CellVertPos pos;
+	};
+
+	// The three edge ends of each corner, ordered so that (v0 x v1) . v2 > 0 for an uninverted cell
+	constexpr SignedVector gOrientedEdgePosLT[8][3] = {
+	{ // LWR_FNT_LFT
+		{1, LWR_FNT_RGT},
+		{1, LWR_BCK_LFT},
+		{1, UPR_FNT_LFT},
+	},
+	{ // LWR_FNT_RGT
+		{ 1, UPR_FNT_RGT},
+		{ 1, LWR_BCK_RGT},
+		{-1, LWR_FNT_LFT},
+	},
+	{ // LWR_BCK_LFT
+		{-1, LWR_FNT_LFT},
+		{ 1, LWR_BCK_RGT},
+		{ 1, UPR_BCK_LFT},
+	},
+	{ // LWR_BCK_RGT
+		{-1, LWR_BCK_LFT},
+		{-1, LWR_FNT_RGT},
+		{ 1, UPR_BCK_RGT},
+	},
+
+	{ // UPR_FNT_LFT
+		{ 1, UPR_FNT_RGT},
+		{-1, LWR_FNT_LFT},
+		{ 1, UPR_BCK_LFT},
+	},
+	{ // UPR_FNT_RGT
+		{ 1, UPR_BCK_RGT},
+		{-1, LWR_FNT_RGT},
+		{-1, UPR_FNT_LFT},
+	},
+	{ // UPR_BCK_LFT
+		{-1, UPR_FNT_LFT},
+		{-1, LWR_BCK_LFT},
+		{ 1, UPR_BCK_RGT},
+	},
+	{ // UPR_BCK_RGT
+		{-1, UPR_FNT_RGT},
+		{-1, UPR_BCK_LFT},
+		{-1, LWR_BCK_RGT},
+	},
+	};
+
 }
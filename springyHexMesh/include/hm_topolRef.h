@@ -48,6 +48,7 @@ namespace HexahedralMesher {
 		static TopolRef createParallel(const Vector3d& v);
 		static TopolRef createVert(size_t meshIdx, size_t vertIdx);
 		static TopolRef createTriRef(size_t vertIdx[3]);
+		static TopolRef createModelTriRef(size_t meshIdx, size_t triIdx);
 		static TopolRef createPolylineRef(size_t meshIdx, size_t polylineNumber, size_t polylineIndex);
 		static TopolRef createGridEdgeMidPtRef(const GridEdge& edge);
 		static TopolRef createGridFaceCentroidRef(const GridFace& face);
@@ -68,6 +69,10 @@ namespace HexahedralMesher {
 		size_t getPolylineIndex() const;
 		void setPolylineIndex(size_t idx);
 
+		// The model triangle a CLAMP_TRI vertex was last projected to
+		size_t getModelTriIdx() const;
+		void setModelTriIdx(size_t idx);
+
 		size_t getCellIdx() const;
 		GridEdge getEdge() const;
 		FaceNumber getFaceNumber() const;
@@ -124,6 +129,15 @@ namespace HexahedralMesher {
 		return result;
 	}
 
+	inline TopolRef TopolRef::createModelTriRef(size_t meshIdx, size_t triIdx) {
+		TopolRef result;
+		result._clampType = CLAMP_TRI;
+		result._indices[0] = meshIdx;
+		result._indices[1] = triIdx;
+
+		return result;
+	}
+
 	inline TopolRef TopolRef::createPolylineRef(size_t meshIdx, size_t polylineNumber, size_t polylineIndex) {
 		TopolRef result;
 		result._clampType = CLAMP_EDGE;
@@ -201,6 +215,18 @@ namespace HexahedralMesher {
 		_indices[2] = idx;
 	}
 
+	inline size_t TopolRef::getModelTriIdx() const {
+		if (_clampType != CLAMP_TRI)
+			throw "Wrong ClampType for this TopolRef";
+		return _indices[1];
+	}
+
+	inline void TopolRef::setModelTriIdx(size_t idx) {
+		if (_clampType != CLAMP_TRI)
+			throw "Wrong ClampType for this TopolRef";
+		_indices[1] = idx;
+	}
+
 	inline void TopolRef::getTriVertIndices(size_t indices[3]) const {
 		if (_clampType != CLAMP_GRID_TRI_PLANE)
 			throw "Wrong ClampType for this TopolRef";
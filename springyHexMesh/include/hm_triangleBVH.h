@@ -0,0 +1,84 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <vector>
+
+#include <hm_types.h>
+#include <triMesh.h>
+
+namespace HexahedralMesher {
+
+	/*
+	Bounding volume hierarchy over a model's triangles, for projecting CLAMP_TRI vertices onto the surface.
+	Nothing in the pipeline creates CLAMP_TRI clamps yet, the solvers support them for when surface vertices are clamped.
+	It's built once with the model and the queries are const, so any number of threads can share it.
+	*/
+	class CTriangleBVH {
+	public:
+		void build(const TriMesh::CMesh& mesh);
+
+		size_t numTris() const;
+		const Vector3d& getTriNormal(size_t triIdx) const;
+
+		// The hint is the triangle the point was last projected to, SIZE_MAX if there isn't one. Returns false if the tree is empty.
+		bool findClosestPoint(const Vector3d& pt, size_t hintTri, size_t& triIdx, Vector3d& closestPt, double& dist) const;
+		// Closest hit in front of the origin, dir need not be normalized. dist is in units of dir.
+		bool rayCast(const Vector3d& origin, const Vector3d& dir, size_t& triIdx, double& dist) const;
+
+	private:
+		struct Node {
+			Vector3d _min, _max;
+			// Children for an interior node, the range in _triOrder for a leaf
+			size_t _left, _right;
+			bool _leaf;
+		};
+
+		size_t buildNode(size_t begin, size_t end);
+		double calcTriDistSqr(size_t triIdx, const Vector3d& pt, Vector3d& closestPt) const;
+		void searchNode(size_t nodeIdx, const Vector3d& pt, size_t& bestIdx, double& bestDistSqr, Vector3d& bestPt) const;
+
+		std::vector<Vector3d> _triPts; // Three per triangle
+		std::vector<Vector3d> _triNormals;
+		std::vector<Node> _nodes;
+		std::vector<size_t> _triOrder;
+	};
+
+	inline size_t CTriangleBVH::numTris() const {
+		return _triNormals.size();
+	}
+
+	inline const Vector3d& CTriangleBVH::getTriNormal(size_t triIdx) const {
+		return _triNormals[triIdx];
+	}
+
+}
@@ -41,9 +41,12 @@ namespace HexahedralMesher {
 
 	struct ParamsRec;
 
+	// Worker thread slots of each GridVert, slot 0 is the primary
+	const int GRID_VERT_NUM_THREADS = 8;
+
 	template<int NUM_THREADS>
 	class GridVertTempl;
-	using GridVert = GridVertTempl<8>;
+	using GridVert = GridVertTempl<GRID_VERT_NUM_THREADS>;
 
 	class GridEdge;
 	class GridFace;
@@ -59,6 +62,31 @@ namespace HexahedralMesher {
 		UNKNOWN_ERR
 	};
 
+	enum OrthoModel {
+		ORTHO_ANGLE,		// Angle between each corner edge and the normal of the other two, uses atan2
+		ORTHO_DOT_PRODUCT,	// Squared cosines between corner edge pairs, no trig or sqrt
+	};
+
+	enum VertexSolver {
+		VS_STEEPEST_DESCENT,	// Parabolic line search along the energy gradient, up to 10 steps
+		VS_NEWTON,				// Finite difference Hessian on the clamp manifold with a trust region, up to 3 steps
+		VS_REDUCED,				// Steepest descent for free vertices, golden section on lines and edges and Newton on planes for clamped ones
+	};
+
+	enum MeshSolver {
+		MS_VERTEX_SWEEP,	// Each sweep minimizes every vertex in turn, with its neighbors held in place
+		MS_LBFGS,			// L-BFGS over all the vertex degrees of freedom at once
+		MS_FIRE,			// Fast inertial relaxation, one gradient evaluation per iteration and no line search
+		MS_PRIORITY,		// Vertex relaxation, highest energy vertices first, until the budget is used up
+	};
+
+	enum ValidationTier {
+		VT_OFF,			// No checks in the topology mutation paths, use verify between phases
+		VT_SAMPLED,		// A random fraction of the mutations get the paranoid checks
+		VT_FULL,		// Local checks of the entities a mutation touched
+		VT_PARANOID,	// Local checks, neighboring vertices and cells, and search tree re-queries
+	};
+
 	enum Axis {
 		X_AXIS = 0,
 		Y_AXIS = 1,
@@ -120,4 +148,7 @@ namespace HexahedralMesher {
 
 	std::ostream& operator << (std::ostream& out, const ClampType& ct);
 	std::istream& operator >> (std::istream& in, ClampType& ct);
+
+	// Orthonormal axes spanning the plane with this normal
+	void calcTangentAxes(const Vector3d& normal, Vector3d& xAxis, Vector3d& yAxis);
 }
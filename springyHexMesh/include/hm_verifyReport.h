@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+namespace HexahedralMesher {
+
+	/*
+	The problems found by a verify. Any thread may add to it, the first maxEntries are kept with their reasons and the rest are only counted.
+	Errors fail the grid. Warnings are the problems verify has always reported without failing the grid, bad cells and edge vertices off their polylines.
+	*/
+	class VerifyReport {
+	public:
+		struct Entry {
+			bool _isError;
+			const char* _entityType;
+			size_t _idx;
+			std::string _reason;
+		};
+
+		VerifyReport(size_t maxEntries = 10);
+
+		void addError(const char* entityType, size_t idx, const std::string& reason);
+		void addWarning(const char* entityType, size_t idx, const std::string& reason);
+
+		bool passed() const;
+		bool empty() const;
+		size_t numErrors() const;
+		size_t numWarnings() const;
+		// Sorted by entity, so the same grid gives the same report regardless of the thread timing
+		std::vector<Entry> getEntries() const;
+		void dump(std::ostream& out) const;
+
+	private:
+		void add(bool isError, const char* entityType, size_t idx, const std::string& reason);
+
+		size_t _maxEntries;
+		size_t _numErrors = 0, _numWarnings = 0;
+		std::vector<Entry> _entries;
+		mutable std::mutex _mutex;
+	};
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+#include <hm_types.h>
+#include <hm_forwardDeclarations.h>
+
+namespace HexahedralMesher {
+
+	/*
+	Relaxes the highest energy vertices first.
+	Vertices are queued in buckets by log2 of their energy. Each round pops the top of the queue as a batch, relaxes the batch in parallel
+	exactly as a sweep would, then re-queues the batch and its stencil neighbors with their new energies.
+	The workers push into the buckets concurrently, each bucket has its own lock.
+	*/
+	class CVertexScheduler {
+	public:
+		CVertexScheduler(Grid& grid, int clampMask, int numThreads);
+
+		// Runs until maxSeconds or maxRelaxations is used up, or no vertex is above the minimum energy. A limit <= 0 is no limit.
+		// Returns the number of vertex relaxations.
+		size_t run(double maxSeconds, size_t maxRelaxations, std::ostream& logOut);
+
+		size_t numQueued() const;
+
+	private:
+		static const int NUM_BUCKETS = 64;
+
+		struct Bucket {
+			std::mutex _mutex;
+			std::vector<size_t> _verts;
+		};
+
+		int calcBucket(double energy) const;
+		void push(size_t vertIdx, double energy);
+		size_t popBatch(size_t maxCount, std::vector<size_t>& batch);
+		void findStencil(const std::vector<size_t>& batch, std::vector<size_t>& stencil);
+		double calcPrimaryVertexEnergy(size_t vertIdx) const;
+
+		Grid& _grid;
+		int _clampMask;
+		int _numThreads;
+		double _minEnergy;
+		Bucket _buckets[NUM_BUCKETS];
+		// Bucket each vertex is queued in, -1 if it isn't. Older entries in other buckets are skipped when popped.
+		std::vector<int> _vertBucket;
+		std::vector<char> _mark;
+	};
+
+}
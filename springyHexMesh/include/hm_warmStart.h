@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <hm_types.h>
+#include <hm_forwardDeclarations.h>
+#include <hm_paramsRec.h>
+
+namespace HexahedralMesher {
+
+	/*
+	Starts a minimization from the optimized vertex positions of a prior run, read from a saved mesher file.
+
+	If the prior grid has the same topology, the positions are copied, and the prior clamps are kept where they still verify
+	against the current models and have the clamp type of the current vertex. Otherwise the prior displacement of each vertex
+	of the initial lattice is interpolated, trilinearly over the prior lattice cell containing the point, and added to the current
+	points. The lattice is rebuilt from the prior params the way Grid::init builds it, which needs a version 2 mesher file.
+	*/
+	class CWarmStart {
+	public:
+		CWarmStart(Grid& grid);
+
+		bool read(const std::string& path);
+		bool read(std::istream& in);
+
+		bool isSameTopology() const;
+		// Moves the grid's vertices, returns the number moved. Fixed and model vertex clamps don't move.
+		size_t apply();
+
+	private:
+		size_t copyPositions();
+		size_t interpolatePositions();
+		bool buildLattice();
+		bool calcDisplacement(const Vector3d& pt, Vector3d& disp) const;
+		// Moves the vertex and puts it back on its clamp, restoring the old point if the clamp can't be met
+		bool moveVert(size_t vertIdx, const Vector3d& pt);
+
+		Grid& _grid;
+		ParamsRec _priorParams;
+		GridPtr _prior;
+
+		Vector3i _numDivs;
+		Vector3d _latticeMin, _latticeStep;
+		std::vector<Vector3d> _latticeDisp; // Indexed x fastest, (_numDivs + 1) points along each axis
+	};
+
+}
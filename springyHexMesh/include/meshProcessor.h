@@ -47,6 +47,7 @@ All rights reserved
 #include <set>
 #include <memory>
 #include <algorithm>
+#include <sstream>
 
 #include <hm_model.h>
 
@@ -58,6 +59,8 @@ All rights reserved
 #include <hm_gridCell.h>
 #include <hm_grid.h>
 #include <hm_dump.h>
+#include <hm_optSchedule.h>
+#include <hm_convergenceMonitor.h>
 
 using namespace std;
 
@@ -110,6 +113,11 @@ namespace HexahedralMesher {
 			return _params;
 		}
 
+		void setSchedule(const COptSchedule& schedule);
+		const COptSchedule& getSchedule() const;
+		// A saved mesher file whose vertex positions start the run, see CWarmStart. Empty disables.
+		void setWarmStart(const std::string& path);
+
 		size_t getNumModels() const {
 			return _modelPtrs.size();
 		}
@@ -124,12 +132,18 @@ namespace HexahedralMesher {
 
 		void runAsThread();
 		ErrorCode run();
+		// Minimizes the same starting grid with each OrthoModel and reports sweep time and resulting orthogonality
+		ErrorCode benchmarkOrthoModels(int steps);
+		// Times the vertex sweeps for a number of sweeps, then times each global solver from the same start to reach the same energy
+		ErrorCode benchmarkMeshSolvers(int steps);
 
 	private:
 		static void runStat(CMesher* self);
 
 		void init();
 		void makeInitialGrid();
+		// Returns true if the grid was copied from a prior grid with the same topology, which is already minimized
+		bool applyWarmStart();
 
 		double findMinimumGap() const;
 		size_t findVertFaces(size_t vertIdx, std::set<GridFace>& faceSet) const;
@@ -147,7 +161,14 @@ namespace HexahedralMesher {
 		void clampBoundaryEdge(size_t vertIdx);
 		void clampBoundaryCorner(size_t vertIdx);
 
-		void minimizeMesh(int steps, int energyMask, const std::string& filename = "");
+		// Runs the schedule stage with its settings and budget, the params are restored afterwards
+		void runStage(const std::string& stageName, int energyMask, const std::string& filename = "");
+		// Returns the number of sweeps (iterations for the global solvers) run, stopReason receives why they stopped
+		size_t minimizeMesh(int steps, int energyMask, const std::string& filename = "", StopReason* stopReason = nullptr);
+		int minimizeMeshGlobal(int maxIterations, int energyMask, double targetEnergy = 0, StopReason* stopReason = nullptr);
+		size_t minimizeMeshPriority(int steps, int energyMask, StopReason* stopReason = nullptr);
+		void loadBenchmarkStart(std::stringstream& startState);
+		bool restoreBenchmarkStart(std::stringstream& startState);
 
 		double calVertEnergy(size_t vertIdx) const;
 
@@ -156,6 +177,8 @@ namespace HexahedralMesher {
 
 		std::thread* _thread = nullptr;
 		ParamsRec _params;
+		COptSchedule _schedule;
+		std::string _warmStartPath;
 		ReporterPtr _reporter;
 		GridPtr _grid;
 		Dump _dumpObj;
@@ -166,6 +189,18 @@ namespace HexahedralMesher {
 		return modelIdx < _modelPtrs.size();
 	}
 
+	inline void CMesher::setSchedule(const COptSchedule& schedule) {
+		_schedule = schedule;
+	}
+
+	inline const COptSchedule& CMesher::getSchedule() const {
+		return _schedule;
+	}
+
+	inline void CMesher::setWarmStart(const std::string& path) {
+		_warmStartPath = path;
+	}
+
 	inline void CMesher::setReporter(const ReporterPtr& reporter) {
 		_reporter = reporter;
 	}
@@ -0,0 +1,121 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <cmath>
+
+#include <hm_convergenceMonitor.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	CConvergenceMonitor::CConvergenceMonitor(const Params& params)
+		: _params(params)
+	{
+		if (_params.window < 1)
+			_params.window = 1;
+		_energyHistory.reserve(_params.window + 1);
+	}
+
+	bool CConvergenceMonitor::update(double maxMove, double totalEnergy) {
+		size_t histSize = _params.window + 1;
+		if (_energyHistory.size() < histSize)
+			_energyHistory.push_back(totalEnergy);
+		else
+			_energyHistory[_numIterations % histSize] = totalEnergy;
+		_numIterations++;
+
+		if (_params.moveTol > 0 && maxMove < _params.moveTol) {
+			_stopReason = STOP_MOVE_TOLERANCE;
+			return true;
+		}
+
+		if (_energyHistory.size() < histSize)
+			return false;
+
+		// The oldest entry is the next one to be overwritten
+		double oldEnergy = _energyHistory[_numIterations % histSize];
+		double decrease = oldEnergy - totalEnergy;
+		_relativeDecrease = fabs(oldEnergy) > 0 ? decrease / fabs(oldEnergy) : 0;
+
+		if (_params.stopOnStall && decrease <= 0) {
+			_stopReason = STOP_STALLED;
+			return true;
+		}
+
+		if (_params.energyTol > 0 && _relativeDecrease < _params.energyTol) {
+			_stopReason = STOP_ENERGY_TOLERANCE;
+			return true;
+		}
+
+		return false;
+	}
+
+	void CConvergenceMonitor::setStopReason(StopReason reason) {
+		_stopReason = reason;
+	}
+
+	bool CConvergenceMonitor::isConverged(StopReason reason) {
+		switch (reason) {
+		case STOP_MOVE_TOLERANCE:
+		case STOP_ENERGY_TOLERANCE:
+		case STOP_STALLED:
+		case STOP_ACTIVE_SET_EMPTY:
+		case STOP_TARGET_ENERGY:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	const char* CConvergenceMonitor::getStopReasonStr(StopReason reason) {
+		switch (reason) {
+		case STOP_NONE:
+			return "not stopped";
+		case STOP_MAX_ITERATIONS:
+			return "max iterations";
+		case STOP_MOVE_TOLERANCE:
+			return "max move below tolerance";
+		case STOP_ENERGY_TOLERANCE:
+			return "energy decrease below tolerance";
+		case STOP_STALLED:
+			return "energy stalled";
+		case STOP_ACTIVE_SET_EMPTY:
+			return "no active vertices";
+		case STOP_TIME_LIMIT:
+			return "time limit";
+		case STOP_TARGET_ENERGY:
+			return "target energy reached";
+		}
+		return "unknown";
+	}
+
+}
@@ -0,0 +1,347 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <hm_globalOptimizer.h>
+#include <hm_gridVert.h>
+#include <meshProcessor.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	namespace {
+		// FIRE constants from Bitzek et al. 2006
+		const int fireMinPositive = 5;
+		const double fireDtGrow = 1.1;
+		const double fireDtShrink = 0.5;
+		const double fireAlphaStart = 0.1;
+		const double fireAlphaShrink = 0.99;
+	}
+
+	CGlobalOptimizer::CGlobalOptimizer(Grid& grid, MeshSolver solver, int clampMask, int numThreads, int historySize)
+		: _grid(grid)
+		, _solver(solver)
+		, _numThreads(numThreads)
+		, _historySize(historySize)
+	{
+		buildDofMap(clampMask);
+		getDofs(_x);
+		_energy = evaluate(_x, _grad);
+
+		if (_solver == MS_FIRE) {
+			// Size the first time step so the largest force moves a vertex about 5% of its move limit
+			double minMaxMove = DBL_MAX, maxForce = 0;
+			for (const auto& rec : _dofs) {
+				minMaxMove = std::min(minMaxMove, rec._maxMove);
+				maxForce = std::max(maxForce, _grad.segment(rec._offset, rec._numDofs).norm());
+			}
+			_velocity.setZero(_numDofs);
+			_fireDt = maxForce > minNormalizeDivisor ? sqrt(0.05 * minMaxMove / maxForce) : 0;
+			_fireDtMin = 1.0e-3 * _fireDt;
+			_fireDtMax = 10 * _fireDt;
+			_fireAlpha = fireAlphaStart;
+		}
+	}
+
+	void CGlobalOptimizer::buildDofMap(int clampMask) {
+		const int minMask = CLAMP_NONE | CLAMP_EDGE | CLAMP_TRI | CLAMP_PERPENDICULAR | CLAMP_PARALLEL | CLAMP_GRID_TRI_PLANE;
+		const CMesher& mesher = _grid.getMesher();
+
+		_grid.updateConstraintFrames();
+		_grid.iterateVertsOfType(clampMask & minMask, [&](size_t vertIdx)->bool {
+			auto& vert = _grid.getVert(vertIdx);
+			const TopolRef& clamp = vert.getClamp();
+
+			DofRec rec;
+			rec._vertIdx = vertIdx;
+			rec._offset = _numDofs;
+			rec._origin = vert.getPt();
+			rec._maxMove = 0.25 * vert.findVertMinAdjEdgeLength(_grid);
+
+			switch (clamp.getClampType()) {
+			case CLAMP_NONE:
+				rec._numDofs = 3;
+				rec._axes[0] = vX;
+				rec._axes[1] = vY;
+				rec._axes[2] = vZ;
+				break;
+			case CLAMP_PERPENDICULAR:
+			case CLAMP_TRI:
+			case CLAMP_GRID_TRI_PLANE: {
+				// A tri plane moves with its triangle, it's frozen here and the vertex is projected back onto it after each move
+				Grid::ConstraintFrame frame;
+				_grid.getConstraintFrame(vertIdx, frame);
+				rec._numDofs = 2;
+				rec._axes[0] = frame._xAxis;
+				rec._axes[1] = frame._yAxis;
+				break;
+			}
+			case CLAMP_PARALLEL:
+				rec._numDofs = 1;
+				rec._axes[0] = clamp.getVector();
+				break;
+			case CLAMP_EDGE: {
+				const CModelPtr& modelPtr = mesher.getModelPtr(clamp.getMeshIdx());
+				rec._numDofs = 1;
+				rec._arcLength = &modelPtr->getPolylineArcLength(clamp.getPolylineNumber());
+				break;
+			}
+			default:
+				return true;
+			}
+
+			_numDofs += rec._numDofs;
+			_dofs.push_back(rec);
+			return true;
+		});
+	}
+
+	void CGlobalOptimizer::getDofs(VectorXd& x) const {
+		x.setZero(_numDofs);
+		for (const auto& rec : _dofs) {
+			if (rec._arcLength)
+				x[rec._offset] = rec._arcLength->findArcLength(rec._origin);
+		}
+	}
+
+	void CGlobalOptimizer::setDofs(VectorXd& x) {
+		for (const auto& rec : _dofs) {
+			auto& vert = _grid.getVert(rec._vertIdx);
+			if (rec._arcLength) {
+				double& s = x[rec._offset];
+				s = std::min(rec._arcLength->getLength(), std::max(0.0, s));
+				vert.setPoint(rec._arcLength->calcPoint(s));
+
+				size_t plIdx = rec._arcLength->findSegmentIndex(s);
+				if (plIdx != vert.getClamp().getPolylineIndex())
+					vert.getClamp().setPolylineIndex(plIdx);
+			} else {
+				Vector3d pt = rec._origin;
+				for (int i = 0; i < rec._numDofs; i++)
+					pt += x[rec._offset + i] * rec._axes[i];
+				if (vert.getClampType() == CLAMP_TRI) {
+					// Moves in the tangent plane of the starting triangle, then back onto the surface
+					size_t triIdx;
+					pt = _grid.projectToSurface(rec._vertIdx, pt, triIdx);
+					if (triIdx != vert.getClamp().getModelTriIdx())
+						vert.getClamp().setModelTriIdx(triIdx);
+				}
+				vert.setPoint(pt);
+			}
+		}
+
+		// Dependent vertices follow the vertices they're clamped to
+		_grid.clampDependentVerts();
+	}
+
+	double CGlobalOptimizer::evaluate(const VectorXd& x, VectorXd& grad) {
+		_numEvaluations++;
+		_grid.calcEnergyField(_field, _numThreads, true);
+		double energy = _grid.calcTotalEnergy(_field);
+
+		// Chain rule through each vertex's local coordinates, and through the dependent vertices which move with it
+		grad.setZero(_numDofs);
+		for (const auto& rec : _dofs) {
+			Vector3d vertGrad = _field._vertGradient[rec._vertIdx];
+			const Grid::DependentWeight* deps;
+			size_t numDeps = _grid.getDependentVerts(rec._vertIdx, deps);
+			for (size_t i = 0; i < numDeps; i++)
+				vertGrad += deps[i]._weight * _field._vertGradient[deps[i]._vertIdx];
+			if (rec._arcLength)
+				grad[rec._offset] = rec._arcLength->calcDir(x[rec._offset]).dot(vertGrad);
+			else {
+				for (int i = 0; i < rec._numDofs; i++)
+					grad[rec._offset + i] = rec._axes[i].dot(vertGrad);
+			}
+		}
+		return energy;
+	}
+
+	void CGlobalOptimizer::calcDirection(VectorXd& dir) const {
+		// L-BFGS two loop recursion
+		size_t n = _s.size();
+		vector<double> alpha(n), rho(n);
+		VectorXd q = _grad;
+		for (size_t j = n; j > 0; j--) {
+			size_t i = j - 1;
+			rho[i] = 1.0 / _y[i].dot(_s[i]);
+			alpha[i] = rho[i] * _s[i].dot(q);
+			q -= alpha[i] * _y[i];
+		}
+
+		if (n > 0)
+			q *= _s.back().dot(_y.back()) / _y.back().squaredNorm();
+
+		for (size_t i = 0; i < n; i++) {
+			double beta = rho[i] * _y[i].dot(q);
+			q += (alpha[i] - beta) * _s[i];
+		}
+		dir = -q;
+	}
+
+	double CGlobalOptimizer::limitStep(VectorXd& dir) const {
+		// Local coordinates are orthonormal or arc length, so each vertex's part of dir is its move distance
+		double scale = 1;
+		for (const auto& rec : _dofs) {
+			double move = dir.segment(rec._offset, rec._numDofs).norm();
+			if (move * scale > rec._maxMove)
+				scale = rec._maxMove / move;
+		}
+		dir *= scale;
+		return scale;
+	}
+
+	bool CGlobalOptimizer::lineSearch(const VectorXd& dir) {
+		const int maxTries = 10;
+		const double c1 = 1.0e-4;
+
+		double slope = _grad.dot(dir);
+		if (slope >= 0)
+			return false;
+
+		VectorXd x, grad;
+		double alpha = 1;
+		for (int i = 0; i < maxTries; i++) {
+			x = _x + alpha * dir;
+			setDofs(x);
+			double energy = evaluate(x, grad);
+			if (energy <= _energy + c1 * alpha * slope) {
+				VectorXd s = x - _x;
+				VectorXd y = grad - _grad;
+				if (s.dot(y) > minNormalizeDivisor) {
+					if (_s.size() == _historySize) {
+						_s.erase(_s.begin());
+						_y.erase(_y.begin());
+					}
+					_s.push_back(s);
+					_y.push_back(y);
+				}
+
+				_x = x;
+				_grad = grad;
+				_energy = energy;
+				return true;
+			}
+			alpha *= 0.5;
+		}
+
+		setDofs(_x);
+		return false;
+	}
+
+	bool CGlobalOptimizer::step() {
+		if (_numDofs == 0 || _grad.norm() < minNormalizeDivisor)
+			return false;
+
+		switch (_solver) {
+		case MS_FIRE:
+			return stepFIRE();
+		default:
+			return stepLBFGS();
+		}
+	}
+
+	bool CGlobalOptimizer::stepLBFGS() {
+		VectorXd dir;
+		calcDirection(dir);
+		if (dir.dot(_grad) >= 0) {
+			_s.clear();
+			_y.clear();
+			dir = -_grad;
+		}
+		limitStep(dir);
+		if (lineSearch(dir))
+			return true;
+
+		if (_s.empty())
+			return false;
+
+		// The curvature history is stale, restart from steepest descent
+		_s.clear();
+		_y.clear();
+		dir = -_grad;
+		limitStep(dir);
+		return lineSearch(dir);
+	}
+
+	bool CGlobalOptimizer::stepFIRE() {
+		/*
+		Fast inertial relaxation engine. The velocity is steered toward the force while the force keeps doing positive work.
+		When it doesn't, the last half step is taken back, the velocity is zeroed and the time step shrinks.
+		One energy field evaluation per iteration, no line search. Fails once the time step has shrunk below its floor.
+		*/
+		if (_fireDt <= _fireDtMin)
+			return false;
+
+		VectorXd force = -_grad;
+		double power = force.dot(_velocity);
+		if (power > 0) {
+			double forceNorm = force.norm();
+			if (forceNorm > minNormalizeDivisor)
+				_velocity = (1 - _fireAlpha) * _velocity + (_fireAlpha * _velocity.norm() / forceNorm) * force;
+			if (++_fireNumPositive > fireMinPositive) {
+				_fireDt = std::min(_fireDt * fireDtGrow, _fireDtMax);
+				_fireAlpha *= fireAlphaShrink;
+			}
+		} else {
+			_fireNumPositive = 0;
+			_fireAlpha = fireAlphaStart;
+			// The half step back uses the time step the last move was taken with
+			_x -= 0.5 * _fireDt * _velocity;
+			_velocity.setZero();
+			_fireDt *= fireDtShrink;
+			if (_fireDt <= _fireDtMin) {
+				setDofs(_x);
+				_energy = evaluate(_x, _grad);
+				return false;
+			}
+		}
+
+		_velocity += _fireDt * force;
+		VectorXd dx = _fireDt * _velocity;
+		// The velocity is limited with the move, so momentum doesn't build beyond what the vertices can travel
+		_velocity *= limitStep(dx);
+
+		VectorXd x = _x + dx;
+		setDofs(x);
+
+		// A vertex stopped at the end of its polyline loses its velocity along it
+		for (const auto& rec : _dofs) {
+			if (rec._arcLength && x[rec._offset] != _x[rec._offset] + dx[rec._offset])
+				_velocity[rec._offset] = 0;
+		}
+
+		_x = x;
+		_energy = evaluate(_x, _grad);
+		return true;
+	}
+
+}
@@ -29,6 +29,10 @@ This file is part of the SpringHexMesh Project.
 
 #include <tm_defines.h>
 
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
 #include <hm_types.h>
 
 #include <hm_tables.h>
@@ -37,10 +41,16 @@ This file is part of the SpringHexMesh Project.
 #include <hm_gridCell.h>
 #include <hm_gridCellEnergy.h>
 #include <hm_optimizer.h>
+#include <hm_polylineArcLength.h>
 #include <meshProcessor.h>
 
 namespace HexahedralMesher {
 
+	namespace {
+		thread_local size_t tlNumVertexEvaluations = 0;
+		std::atomic<size_t> gNumVertexEvaluations(0);
+	}
+
 	Grid::Grid(CMesher& mesher)
 		: _mesher(&mesher)
 	{}
@@ -120,7 +130,7 @@ namespace HexahedralMesher {
 		bool verifyZeroEnergy = true, doEnergyTests = false;
 
 		if (verifyZeroEnergy) {
-			GridEnergy energyCal(*this);
+			GridEnergy energyCal(*this, getEnergyParams());
 
 			double totalCellEnergy = 0;
 			iterateCells([&](size_t cellIdx)->bool {
@@ -137,47 +147,90 @@ namespace HexahedralMesher {
 	}
 
 	bool Grid::verify() const {
-		if (!GridBase::verify())
+		VerifyReport report;
+		bool result = verify(report);
+		if (!report.empty())
+			report.dump(cout);
+		return result;
+	}
+
+	bool Grid::verify(VerifyReport& report, int numCores) const {
+		if (!GridBase::verify(report, numCores))
 			return false;
 
-		bool passed = true;
-		iterateVerts([&](size_t vertIdx)->bool {
-			const auto& vert = getVert(vertIdx);
-			const auto& clamp = vert.getClamp();
-			switch (clamp.getClampType()) {
-			case CLAMP_EDGE: {
-				auto modelPtr = _mesher->getModelPtr(clamp.getMeshIdx());
-				if (!modelPtr)
-					return false;
-
-				const auto& pl = modelPtr->_polyLines[clamp.getPolylineNumber()];
-				size_t plIdx;
-				double d, t;
-				if (!pl.findClosestPointOnPolyline(*modelPtr, vert.getPt(), plIdx, d, t))
-					return false;
-				if (d > SAME_DIST_TOL)
-					return false;
-				if (plIdx != clamp.getPolylineIndex())
-					return false;
+		vector<size_t> vertIndices;
+		getVertsOfType(CLAMP_EDGE, vertIndices);
+		iteratePrimary(vertIndices.size(), [&](size_t i) {
+			verifyClampPosition(vertIndices[i], report);
+		}, numCores);
 
-				break;
-			}
-			default:
-				break;
-			}
-			return true;
-		}, 1);
+		return true;
+	}
 
-		if (!passed)
+	bool Grid::verifyChanges() const {
+		VerifyReport report;
+		bool result = verifyChanges(report);
+		if (!report.empty())
+			report.dump(cout);
+		return result;
+	}
+
+	bool Grid::verifyChanges(VerifyReport& report) const {
+		if (!isJournalValid())
+			return verify(report);
+
+		vector<size_t> vertIndices, cellIds;
+		findChanges(vertIndices, cellIds);
+		verifyEntities(vertIndices, cellIds, report);
+		if (!report.passed())
 			return false;
 
+		for (size_t vertIdx : vertIndices)
+			verifyClampPosition(vertIdx, report);
+
+		clearJournal();
 		return true;
 	}
 
+	void Grid::verifyClampPosition(size_t vertIdx, VerifyReport& report) const {
+		// An edge vertex off its polyline has never failed the grid
+		const auto& vert = getVert(vertIdx);
+		const auto& clamp = vert.getClamp();
+		switch (clamp.getClampType()) {
+		case CLAMP_EDGE: {
+			auto modelPtr = _mesher->getModelPtr(clamp.getMeshIdx());
+			if (!modelPtr) {
+				report.addWarning("vert", vertIdx, "clamped to a missing model");
+				break;
+			}
+
+			const auto& arcLen = modelPtr->getPolylineArcLength(clamp.getPolylineNumber());
+			size_t plIdx;
+			double d, t;
+			arcLen.findClosestPoint(vert.getPt(), clamp.getPolylineIndex(), plIdx, d, t);
+			if (d > SAME_DIST_TOL)
+				report.addWarning("vert", vertIdx, "off its polyline by " + to_string(d));
+			else if (plIdx != clamp.getPolylineIndex())
+				report.addWarning("vert", vertIdx, "on polyline segment " + to_string(plIdx) + ", clamped to " + to_string(clamp.getPolylineIndex()));
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
 	const ParamsRec& Grid::getParams() const {
 		return _mesher->getParams();
 	}
 
+	GridEnergy::Params Grid::getEnergyParams() const {
+		GridEnergy::Params result;
+		result._orthoModel = getParams().orthoModel;
+		result._kCompress = getParams().kCompress;
+		result._kBend = getParams().kBend;
+		return result;
+	}
+
 	size_t Grid::getVertsFaces(size_t vertIdx, bool includeOpposedPairs, std::vector<GridFace>& faceRefs) const {
 		faceRefs.clear();
 
@@ -212,7 +265,7 @@ namespace HexahedralMesher {
 		// This vertex can't move
 		Vector3d gradient;
 		const TopolRef& clamp = vert.getClamp();
-		int minMask = CLAMP_NONE | CLAMP_EDGE | CLAMP_PERPENDICULAR | CLAMP_PARALLEL | CLAMP_GRID_TRI_PLANE;
+		int minMask = CLAMP_NONE | CLAMP_EDGE | CLAMP_TRI | CLAMP_PERPENDICULAR | CLAMP_PARALLEL | CLAMP_GRID_TRI_PLANE;
 		if (!clamp.matches(clampMask & minMask))
 			return 0;
 
@@ -224,59 +277,87 @@ namespace HexahedralMesher {
 				logOut << "  " << count << ", moveDist: " << moveDist << "\n";
 		};
 
-		switch (clamp.getClampType()) {
+		// Evaluations are counted per thread and published once per vertex
+		size_t startEvaluations = tlNumVertexEvaluations;
+		double result = 0;
+		if (getParams().vertexSolver == VS_NEWTON)
+			result = minimizeVertexEnergyNewton(vertIdx, logFunc);
+		else if (getParams().vertexSolver == VS_REDUCED && clamp.getClampType() != CLAMP_NONE)
+			result = minimizeVertexEnergyReduced(vertIdx, logFunc);
+		else switch (clamp.getClampType()) {
 		case CLAMP_NONE:
-			return minimizeVertexEnergy(vertIdx, logFunc,
-				[&](double dt, Vector3d& gradient)->double {
-					return calcEnergyGradientFree(vertIdx, dt, gradient);
+			result = minimizeVertexEnergy(vertIdx, logFunc,
+				[&](double dt, Vector3d& gradient, KnownValues& known)->double {
+					return calcEnergyGradientFree(vertIdx, dt, gradient, known);
 				});
+			break;
 		case CLAMP_EDGE: {
-			return minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient)->double {
-				return calcEnergyGradientEdge(vertIdx, dt, gradient);
+			result = minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient, KnownValues& known)->double {
+				return calcEnergyGradientEdge(vertIdx, dt, gradient, known);
 			});
+			break;
 		}
 		case CLAMP_PERPENDICULAR:
-			return minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient)->double {
-				return calcEnergyGradientPerpendicular(vertIdx, clamp.getVector(), dt, gradient);
+		case CLAMP_GRID_TRI_PLANE:
+			result = minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient, KnownValues& known)->double {
+				return calcEnergyGradientPerpendicular(vertIdx, dt, gradient, known);
 			});
+			break;
+		case CLAMP_TRI:
+			result = minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient, KnownValues& known)->double {
+				return calcEnergyGradientSurface(vertIdx, dt, gradient, known);
+			});
+			break;
 		case CLAMP_PARALLEL:
-			return minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient)->double {
+			result = minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient, KnownValues& known)->double {
 				gradient = clamp.getVector();
 				return DBL_MAX;
 			});
-		case CLAMP_GRID_TRI_PLANE:
-			return minimizeVertexEnergy(vertIdx, logFunc, [&](double dt, Vector3d& gradient)->double {
-				return calcEnergyGradientTriPlane(vertIdx, dt, gradient);
-			});
+			break;
 		default:
 			break;
 		}
 
-		return 0;
+		gNumVertexEvaluations.fetch_add(tlNumVertexEvaluations - startEvaluations, std::memory_order_relaxed);
+		return result;
+	}
+
+	size_t Grid::getNumVertexEvaluations() {
+		return gNumVertexEvaluations.load();
+	}
+
+	void Grid::resetNumVertexEvaluations() {
+		gNumVertexEvaluations = 0;
 	}
 
 	namespace {
 		const double maxDistFactor = 0.125;
 	}
 
-	double Grid::calcEnergyGradientFree(size_t vertIdx, double dt, Vector3d& gradient) {
+	double Grid::calcEnergyGradientFree(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known) {
 		gradient = Vector3d(0, 0, 0);
 
-		GridVert& vert = getVert(vertIdx);
-		Vector3d originalPos = vert.getPt();
-		Vector3d displacedPos;
-		double e0, e1;
-		e0 = calcVertexEnergy(vertIdx);
+		// The center is known after the first step, the line search evaluated it
+		const Vector3d& originalPos = getVert(vertIdx).getPt();
+		Vector3d pts[4] = { originalPos, originalPos, originalPos, originalPos };
+		double vals[4];
+		for (Axis axis = X_AXIS; axis <= Z_AXIS; axis++)
+			pts[axis + 1][axis] += dt;
+
+		if (std::isnan(known._center)) {
+			calcVertexEnergyAtPositions(vertIdx, pts, 4, vals);
+			known._center = vals[0];
+		} else {
+			calcVertexEnergyAtPositions(vertIdx, pts + 1, 3, vals + 1);
+			vals[0] = known._center;
+		}
+
+		double e0 = vals[0];
 		if (e0 <= 1.0e-6)
 			return 0;
 
 		for (Axis axis = X_AXIS; axis <= Z_AXIS; axis++) {
-			displacedPos = originalPos;
-
-			displacedPos[axis] += dt;
-			e1 = calcVertexEnergyAtPos(vertIdx, displacedPos);
-
-			double slope = (e1 - e0) / dt;
+			double slope = (vals[axis + 1] - e0) / dt;
 			gradient[axis] = slope;
 		}
 
@@ -284,37 +365,35 @@ namespace HexahedralMesher {
 		if (mag > minNormalizeDivisor)
 			gradient = gradient / mag;
 
-		fixGradientDirection(vertIdx, dt, gradient);
-
 		return DBL_MAX;
 	}
 
-	double Grid::calcEnergyGradientPerpendicular(size_t vertIdx, const Vector3d& normal, double dt, Vector3d& gradient) {
+	double Grid::calcEnergyGradientPerpendicular(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known) {
 		gradient = Vector3d(0, 0, 0);
 
-		Vector3d xAxis = vX;
-		if (fabs(xAxis.dot(normal)) > 0.7071) {
-			xAxis = vY;
-			if (fabs(xAxis.dot(normal)) > 0.7071) {
-				xAxis = vZ;
-			}
+		ConstraintFrame frame;
+		getConstraintFrame(vertIdx, frame);
+		const Vector3d& xAxis = frame._xAxis;
+		const Vector3d& yAxis = frame._yAxis;
+
+		const Vector3d& originalPos = getVert(vertIdx).getPt();
+		Vector3d pts[3] = { originalPos, originalPos + dt * xAxis, originalPos + dt * yAxis };
+		double vals[3];
+		if (std::isnan(known._center)) {
+			calcVertexEnergyAtPositions(vertIdx, pts, 3, vals);
+			known._center = vals[0];
+		} else {
+			calcVertexEnergyAtPositions(vertIdx, pts + 1, 2, vals + 1);
+			vals[0] = known._center;
 		}
-		xAxis = (xAxis - normal * normal.dot(xAxis)).normalized();
-		Vector3d yAxis = normal.cross(xAxis);
 
-		double e0, e1;
-		auto& vert = getVert(vertIdx);
-		Vector3d originalPos = vert.getPt();
-		e0 = calcVertexEnergy(vertIdx);
+		double e0 = vals[0];
 		if (e0 < 1.0e-6)
 			return 0;
 
 		for (int i = 0; i < 2; i++) {
 			Vector3d dir((i == 0 ? xAxis : yAxis));
-
-			e1 = calcVertexEnergyAtPos(vertIdx, originalPos + dt * dir);
-
-			double slope = (e1 - e0) / dt;
+			double slope = (vals[i + 1] - e0) / dt;
 			gradient += slope * dir;
 		}
 
@@ -322,27 +401,12 @@ namespace HexahedralMesher {
 		if (mag > minNormalizeDivisor)
 			gradient = gradient / mag;
 
-		fixGradientDirection(vertIdx, dt, gradient);
-
 		return DBL_MAX;
 	}
 
-	double Grid::calcMoveDist(size_t vertIdx, double dt, const Vector3d& gradient) {
-		auto calFunc = [&](const Vector3d& pt)->double {
-			return calcVertexEnergyAtPos(vertIdx, pt);
-		};
-
-		auto& pt0 = getVert(vertIdx).getPt();
-		return SteepestAcent<Vector3d>::calcMoveDist(pt0, dt, gradient, calFunc);
-	}
-
-	void Grid::fixGradientDirection(size_t vertIdx, double dt, Vector3d& gradient) {
-		double moveDist = calcMoveDist(vertIdx, dt, gradient);
-		if (moveDist < 0)
-			gradient = -gradient;
-	}
-
-	double Grid::calcEnergyGradientEdge(size_t vertIdx, double dt, Vector3d& gradient) {
+	double Grid::calcEnergyGradientEdge(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known) {
+		// The vertex may be snapped onto the line below, so nothing evaluated before is reused
+		known.clear();
 		gradient = Vector3d(0, 0, 0);
 		int numGradients = 1;
 		Vector3d gradients[2];
@@ -364,13 +428,13 @@ namespace HexahedralMesher {
 			throw "Bad clamp";
 		}
 		const CModelPtr& modelPtr = _mesher->getModelPtr(clamp.getMeshIdx());
-		const TriMesh::CPolyLine& pl = modelPtr->_polyLines[clamp.getPolylineNumber()];
+		const PolylineArcLength& arcLen = modelPtr->getPolylineArcLength(clamp.getPolylineNumber());
 		size_t plIdx;
 		double d, t;
-		bool needsClamp = !pl.findClosestPointOnPolyline(*modelPtr, vert.getPt(), plIdx, d, t);
+		bool needsClamp = !arcLen.findClosestPoint(vert.getPt(), clamp.getPolylineIndex(), plIdx, d, t);
 
 		// Point is not precisely on the line
-		LineSegment seg = pl.getSegment(*modelPtr, plIdx);
+		LineSegment seg = arcLen.getSegment(plIdx);
 		if (plIdx != clamp.getPolylineIndex()) {
 //			cout << "Vert: " << vertIdx << " shifted plIdx from " << clamp.getPolylineIndex() << " to " << plIdx << "\n";
 			vert.getClamp().setPolylineIndex(plIdx);
@@ -396,13 +460,13 @@ namespace HexahedralMesher {
 			vert.setPoint(seg._pts[1]);
 			needsClamp = false;
 
-			if (plIdx == pl.getVerts().size() - 2) {
+			if (plIdx == arcLen.numSegments() - 1) {
 				gradients[0] = seg._pts[0] - seg._pts[1];
 				safeNormalize();
 			}
 			else {
 				gradients[0] = seg._pts[0] - seg._pts[1];
-				seg = pl.getSegment(*modelPtr, plIdx + 1);
+				seg = arcLen.getSegment(plIdx + 1);
 				gradients[1] = seg._pts[1] - seg._pts[0];
 				numGradients = 2;
 				safeNormalize();
@@ -423,7 +487,7 @@ namespace HexahedralMesher {
 
 		int idx = -1;
 		if (numGradients > 1)
-			idx = chooseBestGradient(vertIdx, dt, gradients, numGradients);
+			idx = chooseBestGradient(vertIdx, dt, gradients, numGradients, known);
 
 		if (idx == -1)
 			return 0;
@@ -431,33 +495,117 @@ namespace HexahedralMesher {
 		return len[idx];
 	}
 
-	int Grid::chooseBestGradient(size_t vertIdx, double dt, const Vector3d gradients[], int numGradients) {
+	int Grid::chooseBestGradient(size_t vertIdx, double dt, const Vector3d gradients[], int numGradients, KnownValues& known) {
+		const int maxGradients = 2;
+		if (numGradients > maxGradients)
+			throw "Too many gradients";
+
+		// All the samples for all the directions share the center point and are evaluated in one call
+		const auto& curPos = getVert(vertIdx).getPt();
+		Vector3d pts[2 * maxGradients + 1];
+		double vals[2 * maxGradients + 1];
+		pts[0] = curPos;
+		for (int i = 0; i < numGradients; i++) {
+			pts[2 * i + 1] = curPos - dt * gradients[i];
+			pts[2 * i + 2] = curPos + dt * gradients[i];
+		}
+		calcVertexEnergyAtPositions(vertIdx, pts, 2 * numGradients + 1, vals);
+
 		int result = -1;
 		double maxSlope = 0;
-		const auto& curPos = getVert(vertIdx).getPt();
 		for (int i = 0; i < numGradients; i++) {
-			double tMin = calcMoveDist(vertIdx, dt, gradients[i]);
+			double fitVals[3] = { vals[2 * i + 1], vals[0], vals[2 * i + 2] };
+			double tMin = LineSearch<Vector3d>::calcMoveDist(fitVals, dt);
 			if (tMin > maxSlope) {
 				maxSlope = tMin;
 				result = i;
 			}
 		}
+
+		// The line search starts with the same samples
+		if (result != -1) {
+			known._minus = vals[2 * result + 1];
+			known._center = vals[0];
+			known._plus = vals[2 * result + 2];
+		}
 		return result;
 	}
 
-	double Grid::calcEnergyGradientTriPlane(size_t vertIdx, double dt, Vector3d& gradient) {
-		const auto& vert = getVert(vertIdx);
-		const auto& clamp = vert.getClamp();
-		size_t triIdx[3];
-		clamp.getTriVertIndices(triIdx);
-		const Vector3d* triPts[3] = {
-			&getVert(triIdx[0]).getPt(),
-			&getVert(triIdx[1]).getPt(),
-			&getVert(triIdx[2]).getPt(),
-		};
+	double Grid::calcEnergyGradientSurface(size_t vertIdx, double dt, Vector3d& gradient, KnownValues& known) {
+		// Like an edge, the vertex is projected back onto the surface before each gradient, so nothing evaluated before is reused
+		known.clear();
+		clampVertexToSurface(vertIdx);
+		return calcEnergyGradientPerpendicular(vertIdx, dt, gradient, known);
+	}
+
+	void Grid::calcConstraintFrame(size_t vertIdx, ConstraintFrame& frame) const {
+		const auto& clamp = getVert(vertIdx).getClamp();
+		if (clamp.getClampType() == CLAMP_PERPENDICULAR)
+			frame._normal = clamp.getVector();
+		else if (clamp.getClampType() == CLAMP_TRI) {
+			const CModelPtr& modelPtr = _mesher->getModelPtr(clamp.getMeshIdx());
+			frame._normal = modelPtr->getTriangleBVH().getTriNormal(clamp.getModelTriIdx());
+		} else {
+			size_t triIdx[3];
+			clamp.getTriVertIndices(triIdx);
+			const Vector3d* triPts[3] = {
+				&getVert(triIdx[0]).getPt(),
+				&getVert(triIdx[1]).getPt(),
+				&getVert(triIdx[2]).getPt(),
+			};
+			frame._normal = triangleNormal(triPts);
+		}
+		calcTangentAxes(frame._normal, frame._xAxis, frame._yAxis);
+	}
+
+	void Grid::updateConstraintFrames() {
+		const int frameMask = CLAMP_PERPENDICULAR | CLAMP_GRID_TRI_PLANE;
+		size_t changeNumber = GridVert::getClampChangeNumber();
+		if (changeNumber != _constraintFramesChangeNumber || _constraintFrameIdx.size() != numVerts()) {
+			_constraintFrameIdx.assign(numVerts(), SIZE_MAX);
+			_constraintFrames.clear();
+			_constraintFrames.reserve(numVertsOfType(frameMask));
+			iterateVertsOfType(frameMask, [&](size_t vertIdx)->bool {
+				_constraintFrameIdx[vertIdx] = _constraintFrames.size();
+				_constraintFrames.push_back(ConstraintFrame());
+				calcConstraintFrame(vertIdx, _constraintFrames.back());
+				return true;
+			});
+			_constraintFramesChangeNumber = changeNumber;
+			return;
+		}
+
+		iterateVertsOfType(CLAMP_GRID_TRI_PLANE, [&](size_t vertIdx)->bool {
+			calcConstraintFrame(vertIdx, _constraintFrames[_constraintFrameIdx[vertIdx]]);
+			return true;
+		});
+	}
+
+	void Grid::updateConstraintFrames(const vector<size_t>& vertIndices) {
+		if (GridVert::getClampChangeNumber() != _constraintFramesChangeNumber || _constraintFrameIdx.size() != numVerts()) {
+			updateConstraintFrames();
+			return;
+		}
+
+		for (size_t vertIdx : vertIndices) {
+			if (getVert(vertIdx).getClampType() == CLAMP_GRID_TRI_PLANE)
+				calcConstraintFrame(vertIdx, _constraintFrames[_constraintFrameIdx[vertIdx]]);
+		}
+	}
 
-		Vector3d normal = triangleNormal(triPts);
-		return calcEnergyGradientPerpendicular(vertIdx, normal, dt, gradient);
+	void Grid::getConstraintFrame(size_t vertIdx, ConstraintFrame& frame) const {
+		if (_constraintFramesChangeNumber == GridVert::getClampChangeNumber() && vertIdx < _constraintFrameIdx.size()) {
+			size_t frameIdx = _constraintFrameIdx[vertIdx];
+			if (frameIdx != SIZE_MAX) {
+				const auto& clamp = getVert(vertIdx).getClamp();
+				// A perpendicular clamp can be given a new vector without changing its type
+				if (clamp.getClampType() != CLAMP_PERPENDICULAR || clamp.getVector() == _constraintFrames[frameIdx]._normal) {
+					frame = _constraintFrames[frameIdx];
+					return;
+				}
+			}
+		}
+		calcConstraintFrame(vertIdx, frame);
 	}
 
 	double Grid::clampVertex(size_t vertIdx) {
@@ -473,11 +621,202 @@ namespace HexahedralMesher {
 		case CLAMP_GRID_TRI_PLANE:
 			clampVertexToTriPlane(vertIdx);
 			return 0;
+		case CLAMP_TRI:
+			return clampVertexToSurface(vertIdx);
 		default:
 			return 0;
 		}
 	}
 
+	void Grid::buildDependentVerts() {
+		clearDependentVerts();
+
+		// Masters of each dependent, recIdx[vertIdx] is the vertex's index in _dependentOrder
+		vector<size_t> recIdx(numVerts(), SIZE_MAX);
+		iterateVertsOfType(CLAMP_CELL_EDGE_CENTER | CLAMP_CELL_FACE_CENTER | CLAMP_GRID_TRI_PLANE, [&](size_t vertIdx)->bool {
+			const auto& clamp = getVert(vertIdx).getClamp();
+			DependentRec rec;
+			rec._vertIdx = vertIdx;
+			switch (clamp.getClampType()) {
+			case CLAMP_CELL_EDGE_CENTER: {
+				GridEdge edge = clamp.getEdge();
+				rec._numMasters = 2;
+				rec._masters[0] = edge.getVert(0);
+				rec._masters[1] = edge.getVert(1);
+				break;
+			}
+			case CLAMP_CELL_FACE_CENTER:
+				if (!cellExists(clamp.getCellIdx()))
+					return true;
+				rec._numMasters = 4;
+				getCell(clamp.getCellIdx()).getFaceIndices(clamp.getFaceNumber(), rec._masters);
+				break;
+			case CLAMP_GRID_TRI_PLANE:
+				_triPlaneVerts.push_back(vertIdx);
+				return true;
+			default:
+				return true;
+			}
+			recIdx[vertIdx] = _dependentOrder.size();
+			_dependentOrder.push_back(rec);
+			return true;
+		});
+
+		// A dependent's masters may be dependents, from nested splits. Sort by depth so masters are placed first.
+		vector<int> depth(_dependentOrder.size(), -1);
+		function<int(size_t)> calcDepth = [&](size_t i)->int {
+			if (depth[i] == -2)
+				throw "Circular dependent vertices";
+			if (depth[i] >= 0)
+				return depth[i];
+			depth[i] = -2;
+			int result = 0;
+			const auto& rec = _dependentOrder[i];
+			for (int j = 0; j < rec._numMasters; j++) {
+				size_t m = recIdx[rec._masters[j]];
+				if (m != SIZE_MAX)
+					result = max(result, calcDepth(m) + 1);
+			}
+			depth[i] = result;
+			return result;
+		};
+		vector<size_t> order(_dependentOrder.size());
+		for (size_t i = 0; i < order.size(); i++) {
+			calcDepth(i);
+			order[i] = i;
+		}
+		stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return depth[a] < depth[b];
+		});
+
+		// Weight of each independent master in each dependent, chained through the intermediate dependents
+		vector<vector<DependentWeight>> influence(_dependentOrder.size());
+		for (size_t i : order) {
+			const auto& rec = _dependentOrder[i];
+			double w = 1.0 / rec._numMasters;
+			auto& infl = influence[i];
+			auto add = [&](size_t masterIdx, double weight) {
+				for (auto& dw : infl) {
+					if (dw._vertIdx == masterIdx) {
+						dw._weight += weight;
+						return;
+					}
+				}
+				infl.push_back({ masterIdx, weight });
+			};
+			for (int j = 0; j < rec._numMasters; j++) {
+				size_t m = recIdx[rec._masters[j]];
+				if (m == SIZE_MAX)
+					add(rec._masters[j], w);
+				else {
+					for (const auto& dw : influence[m])
+						add(dw._vertIdx, w * dw._weight);
+				}
+			}
+		}
+
+		// Invert to the dependents of each master
+		_dependentStart.assign(numVerts() + 1, 0);
+		for (const auto& infl : influence) {
+			for (const auto& dw : infl)
+				_dependentStart[dw._vertIdx + 1]++;
+		}
+		for (size_t i = 0; i < numVerts(); i++)
+			_dependentStart[i + 1] += _dependentStart[i];
+		_dependentWeights.resize(_dependentStart.back());
+		vector<size_t> fill(_dependentStart.begin(), _dependentStart.end() - 1);
+		for (size_t i = 0; i < influence.size(); i++) {
+			for (const auto& dw : influence[i])
+				_dependentWeights[fill[dw._vertIdx]++] = { _dependentOrder[i]._vertIdx, dw._weight };
+		}
+
+		vector<DependentRec> sorted;
+		sorted.reserve(order.size());
+		for (size_t i : order)
+			sorted.push_back(_dependentOrder[i]);
+		_dependentOrder.swap(sorted);
+
+		_dependentRecIdx.assign(numVerts(), SIZE_MAX);
+		for (size_t i = 0; i < _dependentOrder.size(); i++)
+			_dependentRecIdx[_dependentOrder[i]._vertIdx] = i;
+		_dependentVertsBuilt = true;
+	}
+
+	Grid::ScopedDependentVerts::ScopedDependentVerts(Grid& grid)
+		: _grid(grid)
+	{
+		_grid.buildDependentVerts();
+	}
+
+	Grid::ScopedDependentVerts::~ScopedDependentVerts() {
+		_grid.clearDependentVerts();
+	}
+
+	void Grid::clearDependentVerts() {
+		_dependentVertsBuilt = false;
+		_dependentOrder.clear();
+		_dependentRecIdx.clear();
+		_triPlaneVerts.clear();
+		_dependentStart.clear();
+		_dependentWeights.clear();
+	}
+
+	void Grid::clampDependentVerts() {
+		if (_dependentVertsBuilt) {
+			// One pass, the masters are already in place when each dependent is placed
+			for (const auto& rec : _dependentOrder)
+				placeDependentVert(rec);
+			for (size_t vertIdx : _triPlaneVerts)
+				clampVertexToTriPlane(vertIdx);
+			return;
+		}
+
+		iterateVertsOfType(CLAMP_CELL_EDGE_CENTER, [&](size_t vertIdx)->bool {
+			clampVertexToCellEdgeCenter(vertIdx);
+			return true;
+		});
+		iterateVertsOfType(CLAMP_CELL_FACE_CENTER, [&](size_t vertIdx)->bool {
+			clampVertexToCellFaceCenter(vertIdx);
+			return true;
+		});
+		iterateVertsOfType(CLAMP_GRID_TRI_PLANE, [&](size_t vertIdx)->bool {
+			clampVertexToTriPlane(vertIdx);
+			return true;
+		});
+	}
+
+	void Grid::clampDependentVerts(const vector<size_t>& movedVerts, const vector<size_t>& nearVerts) {
+		if (!_dependentVertsBuilt)
+			throw "Dependent vertices are not built";
+
+		// The table's order places masters first, so place the affected records in that order
+		vector<size_t> recs;
+		for (size_t vertIdx : movedVerts) {
+			const DependentWeight* deps;
+			size_t numDeps = getDependentVerts(vertIdx, deps);
+			for (size_t i = 0; i < numDeps; i++)
+				recs.push_back(_dependentRecIdx[deps[i]._vertIdx]);
+		}
+		sort(recs.begin(), recs.end());
+		recs.erase(unique(recs.begin(), recs.end()), recs.end());
+		for (size_t recIdx : recs)
+			placeDependentVert(_dependentOrder[recIdx]);
+
+		for (size_t vertIdx : nearVerts)
+			clampVertexToTriPlane(vertIdx);
+	}
+
+	void Grid::placeDependentVert(const DependentRec& rec) {
+		Vector3d newPt(0, 0, 0);
+		for (int i = 0; i < rec._numMasters; i++)
+			newPt += getVert(rec._masters[i]).getPt();
+		newPt /= rec._numMasters;
+
+		auto& vert = getVert(rec._vertIdx);
+		if ((newPt - vert.getPt()).norm() > OPTIMIZER_TOL)
+			vert.setPoint(newPt);
+	}
+
 	double Grid::clampVertexToCellFaceCenter(size_t vertIdx) {
 		auto& vert = getVert(vertIdx);
 		const auto& clamp = vert.getClamp();
@@ -523,6 +862,34 @@ namespace HexahedralMesher {
 		return dist;
 	}
 
+	Vector3d Grid::projectToSurface(size_t vertIdx, const Vector3d& pt, size_t& triIdx) const {
+		const auto& clamp = getVert(vertIdx).getClamp();
+		const CModelPtr& modelPtr = _mesher->getModelPtr(clamp.getMeshIdx());
+		Vector3d result;
+		double dist;
+		if (!modelPtr->getTriangleBVH().findClosestPoint(pt, clamp.getModelTriIdx(), triIdx, result, dist)) {
+			triIdx = clamp.getModelTriIdx();
+			return pt;
+		}
+		return result;
+	}
+
+	double Grid::clampVertexToSurface(size_t vertIdx) {
+		auto& vert = getVert(vertIdx);
+		if (vert.getClampType() != CLAMP_TRI)
+			return 0;
+
+		size_t triIdx;
+		Vector3d newPt = projectToSurface(vertIdx, vert.getPt(), triIdx);
+		if (triIdx != vert.getClamp().getModelTriIdx())
+			vert.getClamp().setModelTriIdx(triIdx);
+
+		double dist = (newPt - vert.getPt()).norm();
+		if (dist > OPTIMIZER_TOL)
+			vert.setPoint(newPt);
+		return dist;
+	}
+
 	double Grid::clampVertexToCellEdgeCenter(size_t vertIdx) {
 		auto& vert = getVert(vertIdx);
 		const auto& clamp = vert.getClamp();
@@ -549,60 +916,405 @@ namespace HexahedralMesher {
 		const double minEnergy = 1.0e-4;
 
 		double dist = 0;
-		Vector3d originalPos = vert.getPt();
+		Vector3d pos = vert.getPt();
+
+		auto calFunc = [&](const Vector3d pts[], int numPts, double vals[]) {
+			calcVertexEnergyAtPositions(vertIdx, pts, numPts, vals);
+		};
 
-		auto calFunc = [&](const Vector3d& pt)->double {
-			return calcVertexEnergyAtPos(vertIdx, pt);
+		// The optimizer works on a copy of the point so every move goes through setPoint and gets a new change number.
+		// The gradient functions may snap the vertex onto its clamp, so the copy is refreshed afterwards.
+		auto gradFunc = [&](double dt, Vector3d& gradient, KnownValues& known)->double {
+			vert.setPoint(pos);
+			double result = calGrad(dt, gradient, known);
+			pos = vert.getPt();
+			return result;
 		};
 
 		SteepestAcent<Vector3d> asc(minEnergy, differentialDist);
-		dist = asc.run(vert.getPt(), maxOptimizerSteps, maxMove, calFunc, calGrad, logFunc);
+		dist = asc.run(pos, maxOptimizerSteps, maxMove, calFunc, gradFunc, logFunc);
+		vert.setPoint(pos);
+		// The last step was in the tangent plane
+		clampVertexToSurface(vertIdx);
+
+		return dist;
+	}
+
+	template<typename LOG_FUNC>
+	double Grid::minimizeVertexEnergyNewton(size_t vertIdx, LOG_FUNC logFunc) {
+		ScopedSetStash restore(*this, vertIdx);
+
+		auto& vert = getVert(vertIdx);
+		const Vector3d origin = vert.getPt();
+		const TopolRef& clamp = vert.getClamp();
+		switch (clamp.getClampType()) {
+		case CLAMP_NONE:
+			return minimizeVertexEnergyNewton<3>(vertIdx, Vector3d(0, 0, 0), Vector3d::Constant(-DBL_MAX), Vector3d::Constant(DBL_MAX),
+				[&](const Vector3d& u)->Vector3d {
+					return origin + u;
+				}, logFunc);
+
+		case CLAMP_PERPENDICULAR:
+		case CLAMP_GRID_TRI_PLANE: {
+			ConstraintFrame frame;
+			getConstraintFrame(vertIdx, frame);
+			const Vector3d& xAxis = frame._xAxis;
+			const Vector3d& yAxis = frame._yAxis;
+			return minimizeVertexEnergyNewton<2>(vertIdx, Eigen::Vector2d(0, 0), Eigen::Vector2d::Constant(-DBL_MAX), Eigen::Vector2d::Constant(DBL_MAX),
+				[&](const Eigen::Vector2d& u)->Vector3d {
+					return origin + u[0] * xAxis + u[1] * yAxis;
+				}, logFunc);
+		}
+
+		case CLAMP_TRI: {
+			// Local coordinates are in the tangent plane, every trial point is projected back onto the surface
+			ConstraintFrame frame;
+			getConstraintFrame(vertIdx, frame);
+			const Vector3d& xAxis = frame._xAxis;
+			const Vector3d& yAxis = frame._yAxis;
+			double dist = minimizeVertexEnergyNewton<2>(vertIdx, Eigen::Vector2d(0, 0), Eigen::Vector2d::Constant(-DBL_MAX), Eigen::Vector2d::Constant(DBL_MAX),
+				[&](const Eigen::Vector2d& u)->Vector3d {
+					size_t triIdx;
+					return projectToSurface(vertIdx, origin + u[0] * xAxis + u[1] * yAxis, triIdx);
+				}, logFunc);
+			clampVertexToSurface(vertIdx);
+			return dist;
+		}
+
+		case CLAMP_PARALLEL: {
+			const Vector3d dir = clamp.getVector();
+			return minimizeVertexEnergyNewton<1>(vertIdx, Eigen::Matrix<double, 1, 1>::Zero(), Eigen::Matrix<double, 1, 1>(-DBL_MAX), Eigen::Matrix<double, 1, 1>(DBL_MAX),
+				[&](const Eigen::Matrix<double, 1, 1>& u)->Vector3d {
+					return origin + u[0] * dir;
+				}, logFunc);
+		}
+
+		case CLAMP_EDGE: {
+			// The vertex moves by arc length along the whole polyline, so a step can cross the polyline's vertices
+			const CModelPtr& modelPtr = _mesher->getModelPtr(clamp.getMeshIdx());
+			const PolylineArcLength& arcLen = modelPtr->getPolylineArcLength(clamp.getPolylineNumber());
+
+			double s0 = arcLen.findArcLength(origin, clamp.getPolylineIndex());
+			double dist = minimizeVertexEnergyNewton<1>(vertIdx, Eigen::Matrix<double, 1, 1>(s0), Eigen::Matrix<double, 1, 1>::Zero(), Eigen::Matrix<double, 1, 1>(arcLen.getLength()),
+				[&](const Eigen::Matrix<double, 1, 1>& u)->Vector3d {
+					return arcLen.calcPoint(u[0]);
+				}, logFunc);
+
+			size_t plIdx = arcLen.findSegmentIndex(arcLen.findArcLength(vert.getPt(), clamp.getPolylineIndex()));
+			if (plIdx != clamp.getPolylineIndex())
+				vert.getClamp().setPolylineIndex(plIdx);
+			return dist;
+		}
+
+		default:
+			break;
+		}
+
+		return 0;
+	}
+
+	template<typename LOG_FUNC>
+	double Grid::minimizeVertexEnergyReduced(size_t vertIdx, LOG_FUNC logFunc) {
+		const TopolRef& clamp = getVert(vertIdx).getClamp();
+		switch (clamp.getClampType()) {
+		case CLAMP_PERPENDICULAR:
+		case CLAMP_GRID_TRI_PLANE:
+		case CLAMP_TRI:
+			// 2D Newton in the plane's coordinates
+			return minimizeVertexEnergyNewton(vertIdx, logFunc);
+
+		case CLAMP_PARALLEL: {
+			ScopedSetStash restore(*this, vertIdx);
+			const Vector3d origin = getVert(vertIdx).getPt();
+			const Vector3d dir = clamp.getVector();
+			const double maxMove = 0.25 * getVert(vertIdx).findVertMinAdjEdgeLength(*this);
+			return minimizeVertexEnergyLine(vertIdx, 0, -maxMove, maxMove, [&](double t)->Vector3d {
+				return origin + t * dir;
+			}, logFunc);
+		}
+
+		case CLAMP_EDGE: {
+			ScopedSetStash restore(*this, vertIdx);
+			auto& vert = getVert(vertIdx);
+			const CModelPtr& modelPtr = _mesher->getModelPtr(clamp.getMeshIdx());
+			const PolylineArcLength& arcLen = modelPtr->getPolylineArcLength(clamp.getPolylineNumber());
+			const double maxMove = 0.25 * vert.findVertMinAdjEdgeLength(*this);
+
+			double s0 = arcLen.findArcLength(vert.getPt(), clamp.getPolylineIndex());
+			double lower = std::max(0.0, s0 - maxMove);
+			double upper = std::min(arcLen.getLength(), s0 + maxMove);
+			double dist = minimizeVertexEnergyLine(vertIdx, s0, lower, upper, [&](double s)->Vector3d {
+				return arcLen.calcPoint(s);
+			}, logFunc);
+
+			size_t plIdx = arcLen.findSegmentIndex(arcLen.findArcLength(vert.getPt(), clamp.getPolylineIndex()));
+			if (plIdx != clamp.getPolylineIndex())
+				vert.getClamp().setPolylineIndex(plIdx);
+			return dist;
+		}
+
+		default:
+			break;
+		}
+
+		return 0;
+	}
+
+	template<typename MAP_FUNC, typename LOG_FUNC>
+	double Grid::minimizeVertexEnergyLine(size_t vertIdx, double start, double lower, double upper, MAP_FUNC toPoint, LOG_FUNC logFunc) {
+		auto& vert = getVert(vertIdx);
+		const double maxMove = 0.25 * vert.findVertMinAdjEdgeLength(*this);
+		const double minEnergy = 1.0e-6;
+		const int maxEvaluations = 20;
+
+		auto calFunc = [&](const double u[], int numPts, double vals[]) {
+			Vector3d pts[3];
+			for (int i = 0; i < numPts; i++)
+				pts[i] = toPoint(u[i]);
+			calcVertexEnergyAtPositions(vertIdx, pts, numPts, vals);
+		};
+
+		GoldenSection solver(1.0e-3 * maxMove, maxEvaluations);
+		double u = solver.run(start, 0.2 * maxMove, lower, upper, minEnergy, calFunc);
+
+		Vector3d newPt = toPoint(u);
+		double dist = (newPt - vert.getPt()).norm();
+		vert.setPoint(newPt);
+		logFunc(solver.getNumEvaluations(), dist);
+
+		return dist;
+	}
+
+	template<int DIM, typename MAP_FUNC, typename LOG_FUNC>
+	double Grid::minimizeVertexEnergyNewton(size_t vertIdx, const Eigen::Matrix<double, DIM, 1>& start,
+		const Eigen::Matrix<double, DIM, 1>& lower, const Eigen::Matrix<double, DIM, 1>& upper, MAP_FUNC toPoint, LOG_FUNC logFunc) {
+		using Solver = NewtonTrustRegion<DIM>;
+
+		auto& vert = getVert(vertIdx);
+		const int maxNewtonSteps = 3;
+		const double maxMove = 0.25 * vert.findVertMinAdjEdgeLength(*this);
+		const double stencilSize = 1.0e-3 * maxMove;
+		const double minEnergy = 1.0e-6;
+
+		auto calFunc = [&](const typename Solver::Vec u[], int numPts, double vals[]) {
+			Vector3d pts[Solver::NUM_STENCIL_PTS];
+			for (int i = 0; i < numPts; i++)
+				pts[i] = toPoint(u[i]);
+			calcVertexEnergyAtPositions(vertIdx, pts, numPts, vals);
+		};
+
+		typename Solver::Vec u = start;
+		Solver solver(minEnergy, stencilSize, 0.2 * maxMove, maxMove);
+		solver.run(u, maxNewtonSteps, maxMove, lower, upper, calFunc, logFunc);
+
+		Vector3d newPt = toPoint(u);
+		double dist = (newPt - vert.getPt()).norm();
+		vert.setPoint(newPt);
 
 		return dist;
 	}
 
 	double Grid::calcCellEnergy(size_t cellId) const {
-		GridEnergy eCal(*this);
+		GridEnergy eCal(*this, getEnergyParams());
 		const GridCell& cell = getCell(cellId);
 		return eCal.calcTotalEnergy(cell);
 	}
 
 	double Grid::calcVertexEnergy(size_t vertIdx) const {
-		GridEnergy eCal(*this);
+		tlNumVertexEvaluations++;
+		GridEnergy eCal(*this, getEnergyParams());
 		const GridVert& vert = getVert(vertIdx);
 		return eCal.calcTotalEnergy(vert);
 	}
 
 	double Grid::calcVertexEnergyAtPos(size_t vertIdx, const Vector3d& atPt) {
-		GridEnergy eCal(*this);
+		tlNumVertexEvaluations++;
+		GridEnergy eCal(*this, getEnergyParams());
 		GridVert& vert = getVert(vertIdx);
 		Vector3d originalPt = vert.getPt();
+		size_t originalChangeNumber = vert.getChangeNumber();
 
 		vert.setPoint(atPt);
 		double result = eCal.calcTotalEnergy(vert);
-		vert.setPoint(originalPt);
+		vert.restorePoint(originalPt, originalChangeNumber);
 
 		return result;
 	}
 
+	void Grid::calcVertexEnergyAtPositions(size_t vertIdx, const Vector3d pts[], int numPts, double energies[]) const {
+		tlNumVertexEvaluations += numPts;
+
+		const DependentWeight* deps;
+		size_t numDeps = getDependentVerts(vertIdx, deps);
+		if (numDeps > 0) {
+			calcVertexEnergyAtPositionsWithDependents(vertIdx, pts, numPts, energies, deps, numDeps);
+			return;
+		}
+
+		GridEnergy eCal(*this, getEnergyParams());
+		const GridVert& vert = getVert(vertIdx);
+
+		for (int i = 0; i < numPts; i++)
+			energies[i] = 0;
+
+		// Cell outer, candidate inner. Each cell's corners and rest lengths are loaded once and reused by every candidate.
+		for (size_t cellIdx : vert.getCellIndices()) {
+			const auto& cell = getCell(cellIdx);
+			CellVertPos pos = cell.getVertsPos(vertIdx);
+			Vector3d cellPts[8];
+			for (int i = 0; i < 8; i++)
+				cellPts[i] = getVert(cell.getVertIdx((CellVertPos)i)).getPt();
+
+			for (int i = 0; i < numPts; i++) {
+				cellPts[pos] = pts[i];
+				energies[i] += eCal.calcTotalEnergy(cell, cellPts);
+			}
+		}
+	}
+
+	void Grid::calcVertexEnergyAtPositionsWithDependents(size_t vertIdx, const Vector3d pts[], int numPts, double energies[],
+		const DependentWeight* deps, size_t numDeps) const {
+		GridEnergy eCal(*this, getEnergyParams());
+		const Vector3d& vertPt = getVert(vertIdx).getPt();
+
+		// The dependents move by their weight times the vertex's move, so their cells are scored too
+		thread_local vector<size_t> cells;
+		cells = getVert(vertIdx).getCellIndices();
+		for (size_t i = 0; i < numDeps; i++) {
+			const auto& depCells = getVert(deps[i]._vertIdx).getCellIndices();
+			cells.insert(cells.end(), depCells.begin(), depCells.end());
+		}
+		sort(cells.begin(), cells.end());
+		cells.erase(unique(cells.begin(), cells.end()), cells.end());
+
+		for (int i = 0; i < numPts; i++)
+			energies[i] = 0;
+
+		for (size_t cellIdx : cells) {
+			const auto& cell = getCell(cellIdx);
+			Vector3d basePts[8], cellPts[8];
+			double weights[8];
+			for (int j = 0; j < 8; j++) {
+				size_t cornerIdx = cell.getVertIdx((CellVertPos)j);
+				basePts[j] = getVert(cornerIdx).getPt();
+				weights[j] = cornerIdx == vertIdx ? 1 : 0;
+				for (size_t k = 0; k < numDeps && weights[j] == 0; k++) {
+					if (deps[k]._vertIdx == cornerIdx)
+						weights[j] = deps[k]._weight;
+				}
+			}
+
+			for (int i = 0; i < numPts; i++) {
+				Vector3d delta = pts[i] - vertPt;
+				for (int j = 0; j < 8; j++)
+					cellPts[j] = basePts[j] + weights[j] * delta;
+				energies[i] += eCal.calcTotalEnergy(cell, cellPts);
+			}
+		}
+	}
+
 	double Grid::calcVertexOrthoEnergy(size_t vertIdx) const {
-		GridEnergy eCal(*this);
+		GridEnergy eCal(*this, getEnergyParams());
 		const GridVert& vert = getVert(vertIdx);
 		return eCal.calcBendEnergy(vert);
 	}
 
 	double Grid::calcVertexOrthoEnergyAtPos(size_t vertIdx, const Vector3d& atPt) {
-		GridEnergy eCal(*this);
+		GridEnergy eCal(*this, getEnergyParams());
 		GridVert& vert = getVert(vertIdx);
 		Vector3d originalPt = vert.getPt();
+		size_t originalChangeNumber = vert.getChangeNumber();
 
 		vert.setPoint(atPt);
 		double result = eCal.calcBendEnergy(vert);
-		vert.setPoint(originalPt);
+		vert.restorePoint(originalPt, originalChangeNumber);
 
 		return result;
 	}
 
+	void Grid::calcEnergyField(EnergyField& field, int numThreads, bool calcGradient, double dt) const {
+		/*
+		Two passes so no two threads ever write the same entry.
+		The cell pass visits each cell once and writes only that cell's entries.
+		The vertex pass gathers the cell results into each vertex.
+		*/
+		GridEnergy eCal(*this, getEnergyParams());
+		const auto& params = getEnergyParams();
+
+		field._cellEnergy.resize(numCells());
+		field._vertEnergy.resize(numVerts());
+		if (calcGradient) {
+			field._cellCornerGradient.resize(8 * numCells());
+			field._vertGradient.resize(numVerts());
+		}
+
+		iterateCells([&](size_t cellIdx)->bool {
+			const auto& cell = getCell(cellIdx);
+			Vector3d pts[8];
+			for (int i = 0; i < 8; i++)
+				pts[i] = getVert(cell.getVertIdx((CellVertPos)i)).getPrimaryPt();
+
+			// Cells whose vertices haven't moved since the last evaluation reuse their energies
+			auto& cache = cell.getPrimaryEnergyCache(*this);
+			double bend = 0, compression = 0;
+			if (params._kBend > 0) {
+				if (cache._bendEnergy < 0 || cache._bendModel != params._orthoModel) {
+					cache._bendEnergy = eCal.calcBendEnergy(pts);
+					cache._bendModel = params._orthoModel;
+				}
+				bend = cache._bendEnergy;
+			}
+			if (params._kCompress > 0) {
+				if (cache._compressionEnergy < 0)
+					cache._compressionEnergy = eCal.calcCompressionEnergy(cell, pts);
+				compression = cache._compressionEnergy;
+			}
+
+			double e0 = eCal.calcTotalEnergy(bend, compression);
+			field._cellEnergy[cellIdx] = e0;
+
+			if (calcGradient) {
+				Vector3d* cornerGrads = &field._cellCornerGradient[8 * cellIdx];
+				for (int i = 0; i < 8; i++) {
+					Vector3d& grad = cornerGrads[i];
+					Vector3d originalPt = pts[i];
+					for (int axis = 0; axis < 3; axis++) {
+						pts[i][axis] += dt;
+						grad[axis] = (eCal.calcTotalEnergy(cell, pts) - e0) / dt;
+						pts[i] = originalPt;
+					}
+				}
+			}
+			return true;
+		}, numThreads);
+
+		iterateVerts([&](size_t vertIdx)->bool {
+			const auto& vert = getVert(vertIdx);
+			double e = 0;
+			Vector3d grad(0, 0, 0);
+			for (size_t cellIdx : vert.getCellIndices()) {
+				e += field._cellEnergy[cellIdx];
+				if (calcGradient) {
+					CellVertPos pos = getCell(cellIdx).getVertsPos(vertIdx);
+					grad += field._cellCornerGradient[8 * cellIdx + pos];
+				}
+			}
+			field._vertEnergy[vertIdx] = e;
+			if (calcGradient)
+				field._vertGradient[vertIdx] = grad;
+			return true;
+		}, numThreads);
+	}
+
+	double Grid::calcTotalEnergy(const EnergyField& field) const {
+		double result = 0;
+		iterateCells([&](size_t cellIdx)->bool {
+			result += field._cellEnergy[cellIdx];
+			return true;
+		});
+		return result;
+	}
+
 	Vector3d Grid::calcTriangleCentroid(size_t vertIdx[3]) const {
 		const Vector3d* pts[3] = {
 			&getVert(vertIdx[0]).getPt(),
@@ -619,7 +1331,9 @@ namespace HexahedralMesher {
 		const auto& vert = _grid.getVert(vertIdx);
 
 		_pt = vert.getPt();
+		_changeNumber = vert.getChangeNumber();
 		_clamp = vert.getClamp();
+		GridEnergy::setCacheWritesEnabled(false);
 	}
 
 	Grid::ScopedSetStash::~ScopedSetStash() {
@@ -628,8 +1342,9 @@ namespace HexahedralMesher {
 		vert.setStashPoint(vert.getPt());
 		vert.setStashClamp(_grid, vert.getClamp());
 
-		vert.setPoint(_pt);
+		vert.restorePoint(_pt, _changeNumber);
 		vert.setClamp(_grid, _clamp);
+		GridEnergy::setCacheWritesEnabled(true);
 	}
 
 }
\ No newline at end of file
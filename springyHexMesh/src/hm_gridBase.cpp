@@ -32,8 +32,10 @@ This file is part of the SpringHexMesh Project.
 #include <hm_gridBase.h>
 
 #include <set>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <random>
 
 #include <hm_tables.h>
 #include <hm_gridVert.h>
@@ -58,11 +60,13 @@ namespace HexahedralMesher {
 		_verts.clear();
 		_cellIndexMap.clear();
 		_cellStorage.clear();
+		_splitHierarchy.clear();
 		_vertTree.clear();;
+		invalidateJournal();
 	}
 
 	void GridBase::save(std::ostream& out) const {
-		out << "GridBase version 1\n";
+		out << "GridBase version 2\n";
 
 		out << "Verts " << _verts.size() << "\n";
 		for (const auto& vert : _verts)
@@ -79,15 +83,28 @@ namespace HexahedralMesher {
 		for (const auto& cell : _cellStorage)
 			cell.save(out);
 
+		out << "SplitHierarchy " << _splitHierarchy.size() << "\n";
+		for (const auto& rec : _splitHierarchy) {
+			out << "PC: ";
+			for (int i = 0; i < 8; i++)
+				out << rec._parentCorners[i] << " ";
+			out << "CH: ";
+			for (int i = 0; i < 8; i++)
+				out << rec._children[i] << " ";
+			out << "\n";
+		}
 	}
 
 	bool GridBase::read(istream& in) {
+		invalidateJournal();
 		string str1, str2;
 		int version;
 		in >> str1 >> str2 >> version;
 		if (str1 == "GridBase" && str2 == "version") {
 			if (version == 1)
 				return readVersion1(in);
+			else if (version == 2)
+				return readVersion2(in);
 		}
 		return false;
 	}
@@ -125,6 +142,7 @@ namespace HexahedralMesher {
 		// We need the vertex tree for building the disorganized mesh.
 		_vertTree.add(bb, result);
 		verifyVertCount();
+		journalVert(result);
 		return result;
 	}
 
@@ -137,9 +155,11 @@ namespace HexahedralMesher {
 		newCell._id = cellId;
 		newCell.attach(*this);
 
-		if (!newCell.verify(*this, true)) {
+		ValidationTier tier = sampleValidationTier();
+		if (tier != VT_OFF && !newCell.verify(*this, tier == VT_PARANOID)) {
 			throw "New cell is invald";
 		}
+		journalCell(cellId);
 		return cellId;
 	}
 
@@ -155,6 +175,8 @@ namespace HexahedralMesher {
 
 		dead.detach(*this);
 		_cellIndexMap[cellId] = stm1;
+		for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++)
+			journalVert(verts[p]);
 
 		if (_cellStorage.size() > 1) {
 			// Repoint the entry pointing to the back to the empty entry
@@ -171,13 +193,14 @@ namespace HexahedralMesher {
 			// pop the back
 			_cellStorage.pop_back();
 
-			for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++) {
-				const auto& vert = getVert(verts[p]);
-				if (!vert.verify(*this)) {
-					throw "Bad vert after deleting cell";
+			if (sampleValidationTier() != VT_OFF) {
+				for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++) {
+					const auto& vert = getVert(verts[p]);
+					if (!vert.verify(*this)) {
+						throw "Bad vert after deleting cell";
+					}
 				}
 			}
-
 		}
 #if 0
 		if (!verify()) {
@@ -187,10 +210,9 @@ namespace HexahedralMesher {
 	}
 
 	bool GridBase::setVertPos(size_t vertIdx, const Vector3d& pt) {
+		ValidationTier tier = sampleValidationTier();
 		GridVert& vert = _verts[vertIdx];
-		vector<Vector3d> badPts;
-		badPts.push_back(vert.getPt());
-		if (!verifyVertCount())
+		if (tier != VT_OFF && !verifyVertCount())
 			throw "Search tree size mismatch prior to removal.";
 		BoundingBox bb;
 		bb.merge(vert.getPt());
@@ -203,18 +225,21 @@ namespace HexahedralMesher {
 		bb.merge(vert.getPt());
 		if (!_vertTree.add(bb, vertIdx))
 			throw "Failed to add vertex to search tree.";
-		if (!verifyVertCount())
+		if (tier != VT_OFF && !verifyVertCount())
 			throw "Search tree size mismatch after replacement.";
 
-		vector<size_t> vertIndices = _vertTree.find(bb);
-		bool found = false;
-		for (size_t i : vertIndices) {
-			found = found || i == vertIdx;
-		}
-		if (!found) {
-			throw "Could not find the point after replacement.";
+		if (tier == VT_PARANOID) {
+			vector<size_t> vertIndices = _vertTree.find(bb);
+			bool found = false;
+			for (size_t i : vertIndices) {
+				found = found || i == vertIdx;
+			}
+			if (!found) {
+				throw "Could not find the point after replacement.";
+			}
+			_verts[vertIdx].verify(*this, true);
 		}
-		_verts[vertIdx].verify(*this, vertIdx);
+		journalVert(vertIdx);
 		return true;
 	}
 
@@ -244,52 +269,181 @@ namespace HexahedralMesher {
 		}
 	}
 
-	bool GridBase::verify() const {
-		iterateCells([&](size_t cellId) {
-			const auto& cell = getCell(cellId);
-			if (cell.getId() != cellId)
-				return false;
-			bool cr = cell.verify(*this, false);
-			if (!cr) {
-				cell.verify(*this, false);
+	bool GridBase::isSplitRecValid(const CellSplitRec& rec) const {
+		for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++) {
+			size_t childId = rec._children[p];
+			if (!cellExists(childId) || getCell(childId).getVertIdx(p) != rec._parentCorners[p])
 				return false;
-			}
-			return true;
-		});
+		}
+		return true;
+	}
 
-		for (size_t vertIdx = 0; vertIdx < _verts.size(); vertIdx++) {
-			const auto& vert = _verts[vertIdx];
-			if (vert.getIndex() != vertIdx)
-				return false;
-			bool cr = vert.verify(*this, false);
-			if (!cr) {
-				vert.verify(*this, vertIdx);
-				return false;
-			}
+	bool GridBase::verify() const {
+		VerifyReport report;
+		bool result = verify(report);
+		if (!report.empty())
+			report.dump(cout);
+		return result;
+	}
+
+	bool GridBase::verify(VerifyReport& report, int numCores) const {
+		iteratePrimary(_cellIndexMap.size(), [&](size_t cellId) {
+			if (cellExists(cellId))
+				verifyCell(cellId, report);
+		}, numCores);
+
+		iteratePrimary(_verts.size(), [&](size_t vertIdx) {
+			verifyVert(vertIdx, report);
+		}, numCores);
+
+		if (!report.passed())
+			return false;
+
+		clearJournal();
+		return true;
+	}
+
+	void GridBase::verifyCell(size_t cellId, VerifyReport& report) const {
+		// Bad cells have never failed the grid
+		const auto& cell = getCell(cellId);
+		string reason;
+		if (cell.getId() != cellId)
+			report.addWarning("cell", cellId, "stored with id " + to_string(cell.getId()));
+		else if (!cell.verify(*this, reason))
+			report.addWarning("cell", cellId, reason);
+	}
+
+	void GridBase::verifyVert(size_t vertIdx, VerifyReport& report) const {
+		const auto& vert = _verts[vertIdx];
+		string reason;
+		if (vert.getIndex() != vertIdx)
+			report.addError("vert", vertIdx, "stored with index " + to_string(vert.getIndex()));
+		else if (!vert.verify(*this, reason))
+			report.addError("vert", vertIdx, reason);
+	}
+
+	bool GridBase::verifyChanges() const {
+		VerifyReport report;
+		bool result = verifyChanges(report);
+		if (!report.empty())
+			report.dump(cout);
+		return result;
+	}
+
+	bool GridBase::verifyChanges(VerifyReport& report) const {
+		if (!isJournalValid())
+			return verify(report);
+
+		vector<size_t> vertIndices, cellIds;
+		findChanges(vertIndices, cellIds);
+		verifyEntities(vertIndices, cellIds, report);
+		if (!report.passed())
+			return false;
+
+		clearJournal();
+		return true;
+	}
+
+	void GridBase::journalVert(size_t vertIdx) const {
+		if (!_journalValid)
+			return;
+		if (vertIdx >= _vertJournaled.size())
+			_vertJournaled.resize(std::max(_verts.size(), vertIdx + 1), 0);
+		if (!_vertJournaled[vertIdx]) {
+			_vertJournaled[vertIdx] = 1;
+			_vertJournal.push_back(vertIdx);
 		}
+	}
 
-		verifyVertCount();
+	void GridBase::journalCell(size_t cellId) const {
+		if (!_journalValid)
+			return;
+		if (cellId >= _cellJournaled.size())
+			_cellJournaled.resize(std::max(_cellIndexMap.size(), cellId + 1), 0);
+		if (!_cellJournaled[cellId]) {
+			_cellJournaled[cellId] = 1;
+			_cellJournal.push_back(cellId);
+		}
+	}
 
-		map<size_t, size_t> useMap;
-		for (const auto& vert : _verts) {
-			size_t numCells = vert.getNumCells();
-			auto iter = useMap.find(numCells);
-			if (iter == useMap.end()) {
-				iter = useMap.insert(make_pair(numCells, 0)).first;
+	void GridBase::findChanges(vector<size_t>& vertIndices, vector<size_t>& cellIds) const {
+		vertIndices = _vertJournal;
+		cellIds = _cellJournal;
+
+		// Only a pass over the change numbers, and only if something has been numbered since the last verify
+		if (GridVert::peekNextChangeNumber() > _verifiedChangeNumber) {
+			for (size_t vertIdx = 0; vertIdx < _verts.size(); vertIdx++) {
+				if (_verts[vertIdx].getPrimaryChangeNumber() >= _verifiedChangeNumber)
+					vertIndices.push_back(vertIdx);
 			}
-			iter->second++;
 		}
 
-		size_t numVertsInMap = 0;
-		for (const auto& iter : useMap) {
-			numVertsInMap += iter.second;
+		// A vertex's cells check its position and links, a cell's vertices check their links to it
+		size_t numChangedVerts = vertIndices.size();
+		for (size_t i = 0; i < numChangedVerts; i++) {
+			if (vertExists(vertIndices[i])) {
+				const auto& cellIndices = _verts[vertIndices[i]].getCellIndices();
+				cellIds.insert(cellIds.end(), cellIndices.begin(), cellIndices.end());
+			}
 		}
-		if (numVertsInMap != _verts.size()) {
-			cout << "Unexpected vert usage map.\n";
-			return false;
+		for (size_t cellId : cellIds) {
+			if (cellId < _cellIndexMap.size() && cellExists(cellId)) {
+				const auto& cell = getCell(cellId);
+				for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++)
+					vertIndices.push_back(cell.getVertIdx(p));
+			}
 		}
 
-		return true;
+		sort(vertIndices.begin(), vertIndices.end());
+		vertIndices.erase(unique(vertIndices.begin(), vertIndices.end()), vertIndices.end());
+		sort(cellIds.begin(), cellIds.end());
+		cellIds.erase(unique(cellIds.begin(), cellIds.end()), cellIds.end());
+	}
+
+	void GridBase::verifyEntities(const vector<size_t>& vertIndices, const vector<size_t>& cellIds, VerifyReport& report) const {
+		for (size_t cellId : cellIds) {
+			// A deleted cell's vertices are checked instead
+			if (cellId < _cellIndexMap.size() && cellExists(cellId))
+				verifyCell(cellId, report);
+		}
+
+		for (size_t vertIdx : vertIndices) {
+			if (vertExists(vertIdx))
+				verifyVert(vertIdx, report);
+			else
+				report.addError("vert", vertIdx, "doesn't exist");
+		}
+	}
+
+	void GridBase::clearJournal() const {
+		for (size_t vertIdx : _vertJournal)
+			_vertJournaled[vertIdx] = 0;
+		for (size_t cellId : _cellJournal)
+			_cellJournaled[cellId] = 0;
+		_vertJournal.clear();
+		_cellJournal.clear();
+		_verifiedChangeNumber = GridVert::peekNextChangeNumber();
+		_journalValid = true;
+	}
+
+	void GridBase::invalidateJournal() {
+		clearJournal();
+		_journalValid = false;
+	}
+
+	void GridBase::setValidationTier(ValidationTier tier, double sampleRate) {
+		_validationTier = tier;
+		_validationSampleRate = sampleRate;
+	}
+
+	ValidationTier GridBase::sampleValidationTier() const {
+		if (_validationTier != VT_SAMPLED)
+			return _validationTier;
+
+		// Per thread so the splitter and sweep threads don't contend, seeded per thread so runs are repeatable
+		thread_local minstd_rand gen((unsigned int)(getThreadNumber() + 1));
+		thread_local uniform_real_distribution<double> dist(0.0, 1.0);
+		return dist(gen) < _validationSampleRate ? VT_PARANOID : VT_OFF;
 	}
 
 	bool GridBase::verifyVertCount(size_t delta) const {
@@ -300,13 +454,45 @@ namespace HexahedralMesher {
 	}
 
 	size_t GridBase::numClampedVerts() const {
-		size_t num = 0;
-		for (const auto& vert : _verts) {
-			if (vert.getClampType() != CLAMP_NONE) {
-				num++;
-			}
+		return numVerts() - numVertsOfType(CLAMP_NONE);
+	}
+
+	void GridBase::updateClampBuckets() const {
+		size_t changeNumber = GridVert::getClampChangeNumber();
+		if (changeNumber == _clampBucketsChangeNumber && _verts.size() == _clampBucketsNumVerts)
+			return;
+
+		for (auto& bucket : _clampBuckets)
+			bucket.clear();
+		for (size_t vertIdx = 0; vertIdx < _verts.size(); vertIdx++) {
+			int bucketIdx = 0;
+			for (int type = _verts[vertIdx].getClampType(); type != 0; type >>= 1)
+				bucketIdx++;
+			_clampBuckets[bucketIdx].push_back(vertIdx);
+		}
+
+		_clampBucketsChangeNumber = changeNumber;
+		_clampBucketsNumVerts = _verts.size();
+	}
+
+	void GridBase::getVertsOfType(int clampMask, vector<size_t>& vertIndices) const {
+		updateClampBuckets();
+		vertIndices.clear();
+		for (int i = 1; i < NUM_CLAMP_BUCKETS; i++) {
+			int type = 1 << (i - 1);
+			if ((type & clampMask) != 0)
+				vertIndices.insert(vertIndices.end(), _clampBuckets[i].begin(), _clampBuckets[i].end());
 		}
-		return num;
+	}
+
+	size_t GridBase::numVertsOfType(int clampMask) const {
+		updateClampBuckets();
+		size_t result = 0;
+		for (int i = 1; i < NUM_CLAMP_BUCKETS; i++) {
+			if (((1 << (i - 1)) & clampMask) != 0)
+				result += _clampBuckets[i].size();
+		}
+		return result;
 	}
 
 	void GridBase::dumpText(ostream& out) const {
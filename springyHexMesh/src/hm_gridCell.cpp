@@ -41,6 +41,7 @@ This file is part of the SpringHexMesh Project.
 #include <hm_gridEdge.h>
 #include <hm_grid.h>
 #include <hm_tables.h>
+#include <hm_cellKernels.h>
 #include <hm_dump.h>
 
 namespace HexahedralMesher {
@@ -145,165 +146,180 @@ namespace HexahedralMesher {
 	}
 
 	bool GridCell::verify(const GridBase& grid, bool verifyVerts) const {
+		string reason;
+		if (!verify(grid, reason)) {
+			cout << _id << " " << reason << "\n";
+			return false;
+		}
+
+		if (verifyVerts) {
+			for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++) {
+				const GridVert& vert0 = grid.getVert(_vertIndices[p]);
+
+				// Each position in the vertex can only be occupied by one cell, this one
+				if (!vert0.verify(grid)) {
+					cout << _id << " bad vertex\n";
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool GridCell::verify(const GridBase& grid, string& reason) const {
 		double vol = calcVolume(grid);
 		if (vol <= SAME_DIST_TOL * SAME_DIST_TOL * SAME_DIST_TOL || vol > 1.5) {
-			cout << _id << " bad volume\n";
+			reason = "bad volume";
 			return false;
 		}
 
 		for (int i = 0; i < 12; i++) {
 			if (_restEdgeLen[i]< 1.0e-9) {
-				cout << _id << " _restEdgeLen not set\n";
+				reason = "_restEdgeLen not set";
 				return false;
 			}
-
 		}
 
 		for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++) {
-			if (verifyVerts) {
-				size_t vert0Idx = _vertIndices[p];
-				const GridVert& vert0 = grid.getVert(vert0Idx);
-
-				// Each position in the vertex can only be occupied by one cell, this one
-				if (!vert0.verify(grid)) {
-					cout << _id << " bad vertex\n";
-					return false;
-				}
+			if (!verifyEdgeEnds(p)) {
+				reason = "edge ends of corner " + to_string(p) + " don't match the cell";
+				return false;
 			}
+		}
+		return true;
+	}
 
+	bool GridCell::verifyEdgeEnds(CellVertPos p) const {
+		switch (p) {
+		case LWR_FNT_LFT:
+			if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[LWR_FNT_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[LWR_BCK_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_FNT_LFT])
+				return false;
 
-			switch (p) {
-			case LWR_FNT_LFT:
-				if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[LWR_FNT_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[LWR_BCK_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_FNT_LFT])
-					return false;
-
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
-					return false;
-
-				break;
-			case LWR_FNT_RGT:
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[LWR_FNT_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[LWR_BCK_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_FNT_RGT])
-					return false;
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
+				return false;
 
-				if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
-					return false;
+			break;
+		case LWR_FNT_RGT:
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[LWR_FNT_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[LWR_BCK_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_FNT_RGT])
+				return false;
 
-				break;
-			case LWR_BCK_LFT:
-				if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[LWR_BCK_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[LWR_FNT_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_BCK_LFT])
-					return false;
+			if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
+				return false;
 
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
-					return false;
+			break;
+		case LWR_BCK_LFT:
+			if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[LWR_BCK_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[LWR_FNT_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_BCK_LFT])
+				return false;
 
-				break;
-			case LWR_BCK_RGT:
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[LWR_BCK_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[LWR_FNT_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_BCK_RGT])
-					return false;
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
+				return false;
 
-				if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
-					return false;
+			break;
+		case LWR_BCK_RGT:
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[LWR_BCK_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[LWR_FNT_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != _vertIndices[UPR_BCK_RGT])
+				return false;
 
-				break;
+			if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != stm1)
+				return false;
 
-			case UPR_FNT_LFT:
-				if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[UPR_FNT_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[UPR_BCK_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_FNT_LFT])
-					return false;
+			break;
 
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
-					return false;
+		case UPR_FNT_LFT:
+			if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[UPR_FNT_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[UPR_BCK_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_FNT_LFT])
+				return false;
 
-				break;
-			case UPR_FNT_RGT:
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[UPR_FNT_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[UPR_BCK_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_FNT_RGT])
-					return false;
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
+				return false;
 
-				if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
-					return false;
+			break;
+		case UPR_FNT_RGT:
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[UPR_FNT_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != _vertIndices[UPR_BCK_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_FNT_RGT])
+				return false;
 
-				break;
-			case UPR_BCK_LFT:
-				if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[UPR_BCK_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[UPR_FNT_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_BCK_LFT])
-					return false;
+			if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
+				return false;
 
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
-					return false;
+			break;
+		case UPR_BCK_LFT:
+			if (getVertsEdgeEndVertIdx(p, X_POS) != _vertIndices[UPR_BCK_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[UPR_FNT_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_BCK_LFT])
+				return false;
 
-				break;
-			case UPR_BCK_RGT:
-				if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[UPR_BCK_LFT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[UPR_FNT_RGT])
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_BCK_RGT])
-					return false;
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
+				return false;
 
-				if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
-					return false;
-				if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
-					return false;
+			break;
+		case UPR_BCK_RGT:
+			if (getVertsEdgeEndVertIdx(p, X_NEG) != _vertIndices[UPR_BCK_LFT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_NEG) != _vertIndices[UPR_FNT_RGT])
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_NEG) != _vertIndices[LWR_BCK_RGT])
+				return false;
 
-				break;
+			if (getVertsEdgeEndVertIdx(p, X_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Y_POS) != stm1)
+				return false;
+			if (getVertsEdgeEndVertIdx(p, Z_POS) != stm1)
+				return false;
 
-			}
+			break;
 
 		}
 		return true;
@@ -361,16 +377,48 @@ namespace HexahedralMesher {
 	}
 
 	double GridCell::calcVolume(const GridBase& grid) const {
-		double vol = 0;
-		for (FaceNumber fn = BOTTOM; fn < FN_UNKNOWN; fn++) {
-			const Vector3d* tris[2][3];
-			getFaceTriPoints(grid, fn, tris);
-
-			for (int i = 0; i < 2; i++) {
-				vol += volumeUnderTriangle(tris[i], vZ);
+		Vector3d pts[8];
+		for (int i = 0; i < 8; i++)
+			pts[i] = grid.getVert(_vertIndices[i]).getPt();
+		return CellKernels::volume(pts);
+	}
+
+	size_t GridCell::calcVertChangeKey(const GridBase& grid, bool primary) const {
+		size_t key = 0;
+		for (int i = 0; i < 8; i++) {
+			const auto& vert = grid.getVert(_vertIndices[i]);
+			size_t changeNumber = primary ? vert.getPrimaryChangeNumber() : vert.getChangeNumber();
+			key ^= changeNumber + 0x9e3779b97f4a7c15ull + (key << 6) + (key >> 2);
+		}
+		return key;
+	}
+
+	GridCell::EnergyCacheRec* GridCell::getEnergyCache(const GridBase& grid, bool canReplace) const {
+		int thIdx = GridVert::getThreadIndex();
+		auto& rec = _energyCache[thIdx];
+		size_t key = calcVertChangeKey(grid, false);
+		if (rec._key != key) {
+			if (thIdx != 0 && _energyCache[0]._key == key) {
+				// Thread copies start from the primary positions. Primary entries are never written while thread copies are evaluated.
+				rec = _energyCache[0];
+			} else {
+				if (!canReplace)
+					return nullptr;
+				rec = EnergyCacheRec();
+				rec._key = key;
 			}
 		}
-		return vol;
+		return &rec;
+	}
+
+	GridCell::EnergyCacheRec& GridCell::getPrimaryEnergyCache(const GridBase& grid) const {
+		auto& rec = _energyCache[0];
+		size_t key = calcVertChangeKey(grid, true);
+		if (rec._key != key) {
+			rec = EnergyCacheRec();
+			rec._key = key;
+		}
+		return rec;
 	}
 
 	int GridCell::getNumClamped(const Grid& grid, int clampMask) const {
@@ -532,16 +580,11 @@ namespace HexahedralMesher {
 	}
 
 	void GridCell::getFaceTriIndices(FaceNumber faceNumber, size_t tri[2][3]) const {
-		size_t verts[4];
-		getFaceIndices(faceNumber, verts);
-
-		tri[0][0] = verts[0];
-		tri[0][1] = verts[1];
-		tri[0][2] = verts[2];
-
-		tri[1][0] = verts[0];
-		tri[1][1] = verts[2];
-		tri[1][2] = verts[3];
+		for (int i = 0; i < 2; i++) {
+			for (int j = 0; j < 3; j++) {
+				tri[i][j] = _vertIndices[gFaceTriPosLUT[faceNumber][i][j]];
+			}
+		}
 	}
 
 	void GridCell::getFacePoints(const Grid& grid, FaceNumber faceNumber, const Vector3d* points[4]) const {
@@ -553,11 +596,9 @@ namespace HexahedralMesher {
 	}
 
 	void GridCell::getFaceTriPoints(const GridBase& grid, FaceNumber faceNumber, const Vector3d* triPoints[2][3]) const {
-		size_t triIdx[2][3];
-		getFaceTriIndices(faceNumber, triIdx);
 		for (int i = 0; i < 2; i++) {
 			for (int j = 0; j < 3; j++) {
-				triPoints[i][j] = &grid.getVert(triIdx[i][j]).getPt();
+				triPoints[i][j] = &grid.getVert(_vertIndices[gFaceTriPosLUT[faceNumber][i][j]]).getPt();
 			}
 		}
 	}
@@ -34,6 +34,7 @@ This file is part of the SpringHexMesh Project.
 #include <iomanip>
 
 #include <hm_tables.h>
+#include <hm_cellKernels.h>
 #include <hm_paramsRec.h>
 #include <hm_gridVert.h>
 #include <hm_gridCell.h>
@@ -45,6 +46,12 @@ namespace HexahedralMesher {
 
 	constexpr double kScale = 3600; // Constant determined to put the energy value at 1 for 5% displactement of a point
 
+	thread_local bool _cacheWritesEnabled = true;
+
+	void GridEnergy::setCacheWritesEnabled(bool val) {
+		_cacheWritesEnabled = val;
+	}
+
 	GridEnergy::GridEnergy(const Grid& grid, const Params& params)
 		: _grid(grid)
 		, _params(params)
@@ -73,126 +80,133 @@ namespace HexahedralMesher {
 	}
 
 	double GridEnergy::calcTotalEnergy(const GridCell& cell) const {
+		double orthoEnergy = 0, volumeEnergy = 0;
+		auto pCache = cell.getEnergyCache(_grid, _cacheWritesEnabled);
+		if (_params._kBend > 0) {
+			if (!pCache)
+				orthoEnergy = calcBendEnergy(cell);
+			else {
+				if (pCache->_bendEnergy < 0 || pCache->_bendModel != _params._orthoModel) {
+					pCache->_bendEnergy = calcBendEnergy(cell);
+					pCache->_bendModel = _params._orthoModel;
+				}
+				orthoEnergy = pCache->_bendEnergy;
+			}
+		}
+		if (_params._kCompress > 0) {
+			if (!pCache)
+				volumeEnergy = calcCompressionEnergy(cell);
+			else {
+				if (pCache->_compressionEnergy < 0)
+					pCache->_compressionEnergy = calcCompressionEnergy(cell);
+				volumeEnergy = pCache->_compressionEnergy;
+			}
+		}
+
+		return calcTotalEnergy(orthoEnergy, volumeEnergy);
+	}
+
+	void GridEnergy::getCellPoints(const GridCell& cell, Vector3d pts[8]) const {
+		for (int i = 0; i < 8; i++)
+			pts[i] = _grid.getVert(cell.getVertIdx((CellVertPos)i)).getPt();
+	}
+
+	double GridEnergy::calcTotalEnergy(const GridCell& cell, const Vector3d pts[8]) const {
 		double orthoEnergy = 0, volumeEnergy = 0;
 		if (_params._kBend > 0)
-			orthoEnergy = calcBendEnergy(cell);
+			orthoEnergy = calcBendEnergy(pts);
 		if (_params._kCompress > 0)
-			volumeEnergy = calcCompressionEnergy(cell);
+			volumeEnergy = calcCompressionEnergy(cell, pts);
 
 		return calcTotalEnergy(orthoEnergy, volumeEnergy);
 	}
 
 	double GridEnergy::calcCompressionEnergy(const GridCell& cell) const {
+		Vector3d pts[8];
+		getCellPoints(cell, pts);
+		return calcCompressionEnergy(cell, pts);
+	}
+
+	double GridEnergy::calcCompressionEnergy(const GridCell& cell, const Vector3d pts[8]) const {
 		const double k = 10;
-		const double minRatio = 1;
-		double totalEnergy = 0;
-		for (int edgeNum = 0; edgeNum < 12; edgeNum++) {
-			double minLen = minRatio * cell.getRestEdgeLength(edgeNum);
-			GridEdge edge = cell.getEdge(edgeNum);
-			double len = edge.calcLength(_grid);
-			double deltaL = len - minLen;
-			double e = k * deltaL * deltaL;
-			checkNAN(e);
-			totalEnergy += e;
+		double totalEnergy = CellKernels::compressionEnergy(pts, [&](size_t edgeNum) {
+			return cell.getRestEdgeLength((int)edgeNum);
+		}, k);
+		checkNAN(totalEnergy);
+
+		return totalEnergy;
+	}
+
+	double GridEnergy::calcBendEnergy(const GridCell& cell) const {
+		Vector3d pts[8];
+		getCellPoints(cell, pts);
+		return calcBendEnergy(pts);
+	}
+
+	double GridEnergy::calcBendEnergy(const Vector3d pts[8]) const {
+		switch (_params._orthoModel) {
+		case ORTHO_DOT_PRODUCT:
+			return calcBendEnergyDotProduct(pts);
+		default:
+			return calcBendEnergyAngle(pts);
 		}
+	}
+
+	double GridEnergy::calcBendEnergyAngle(const Vector3d pts[8]) const {
+		const double k = 1000;
+		double totalEnergy = CellKernels::bendEnergyAngle(pts, k);
+		checkNAN(totalEnergy);
 
+		if (totalEnergy > 1.0e5) {
+			throw "Energy out of bounds";
+		}
 		return totalEnergy;
 	}
 
-	struct SignedVector {
-		double sign;
-		CellVertPos pos;
-	};
-
-	const SignedVector gOrientedEdgePosLT[8][3] = {
-	{ // LWR_FNT_LFT
-		{1, LWR_FNT_RGT},
-		{1, LWR_BCK_LFT},
-		{1, UPR_FNT_LFT},
-	},
-	{ // LWR_FNT_RGT
-		{ 1, UPR_FNT_RGT},
-		{ 1, LWR_BCK_RGT},
-		{-1, LWR_FNT_LFT},
-	},
-	{ // LWR_BCK_LFT
-		{-1, LWR_FNT_LFT},
-		{ 1, LWR_BCK_RGT},
-		{ 1, UPR_BCK_LFT},
-	},
-	{ // LWR_BCK_RGT
-		{-1, LWR_BCK_LFT},
-		{-1, LWR_FNT_RGT},
-		{ 1, UPR_BCK_RGT},
-	},
-
-	{ // UPR_FNT_LFT
-		{ 1, UPR_FNT_RGT},
-		{-1, LWR_FNT_LFT},
-		{ 1, UPR_BCK_LFT},
-	},
-	{ // UPR_FNT_RGT
-		{ 1, UPR_BCK_RGT},
-		{-1, LWR_FNT_RGT},
-		{-1, UPR_FNT_LFT},
-	},
-	{ // UPR_BCK_LFT
-		{-1, UPR_FNT_LFT},
-		{-1, LWR_BCK_LFT},
-		{ 1, UPR_BCK_RGT},
-	},
-	{ // UPR_BCK_RGT
-		{-1, UPR_FNT_RGT},
-		{-1, UPR_BCK_LFT},
-		{-1, LWR_BCK_RGT},
-	},
-	};
+	double GridEnergy::calcBendEnergyDotProduct(const Vector3d pts[8]) const {
+		/*
+		For a corner deflected by a small angle d, the angle model yields 2 * k * (d / pi)^2, the pair term here yields kPair * d^2.
+		kPair is chosen to match.
+		The pair term can't see an inverted corner, so the signed volume of the corner is added when it's negative.
+		A fully inverted orthogonal corner costs 3 * k in both models.
 
-	double GridEnergy::calcBendEnergy(const GridCell& cell) const {
-		double totalEnergy = 0;
+		All terms are ratios of squared lengths, no sqrt or trig is required.
+		*/
 		const double k = 1000;
+		const double kPair = 2 * k / (EIGEN_PI * EIGEN_PI);
+		const double kInverted = 3 * k;
+
+		double totalEnergy = CellKernels::bendEnergyDotProduct(pts, kPair, kInverted);
+		checkNAN(totalEnergy);
 
+		if (totalEnergy > 1.0e5) {
+			throw "Energy out of bounds";
+		}
+		return totalEnergy;
+	}
+
+	double GridEnergy::calcMaxCornerAngleError(const GridCell& cell) const {
+		// Model independent orthogonality measure, the largest deviation from 90 degrees of any corner edge pair in radians.
+		double maxErr = 0;
 		for (CellVertPos pos0 = LWR_FNT_LFT; pos0 < CVP_UNKNOWN; pos0++) {
-			size_t vertIdx = cell.getVertIdx(pos0);
+			const Vector3d& pt0 = _grid.getVert(cell.getVertIdx(pos0)).getPt();
 			Vector3d edgeDirs[3];
 			const SignedVector* adjEdgePos = gOrientedEdgePosLT[pos0];
+			for (int i = 0; i < 3; i++)
+				edgeDirs[i] = (_grid.getVert(cell.getVertIdx(adjEdgePos[i].pos)).getPt() - pt0).normalized();
+
 			for (int i = 0; i < 3; i++) {
-				const auto& adj = adjEdgePos[i];
-				GridEdge edge(vertIdx, cell.getVertIdx(adj.pos));
-				if (edge.getVert(0) == vertIdx)
-					edgeDirs[i] = edge.calcDir(_grid);
-				else
-					edgeDirs[i] = -edge.calcDir(_grid);
-			}
-			for (int i = 0; i < 3; i++) {
-				const Vector3d& vI = edgeDirs[i];
-				const Vector3d& vJ = edgeDirs[(i + 1) % 3];
-				const Vector3d& vK = edgeDirs[(i + 2) % 3];
-
-				Vector3d normal = vI.cross(vJ);
-
-
-				double cos = normal.dot(vK);
-				checkNAN(cos);
-				double sin = normal.cross(vK).norm();
-				checkNAN(sin);
-				double theta = atan2(sin, cos);
-				double thetaDeg = theta / EIGEN_PI * 180;
-				theta = theta / EIGEN_PI;
-				checkNAN(theta);
-				double e = k * theta * theta;
-				if (e > 0) {
-					int dbgBreak = 1;
-				}
-				totalEnergy += e;
-				checkNAN(totalEnergy);
+				double cosTheta = edgeDirs[i].dot(edgeDirs[(i + 1) % 3]);
+				if (cosTheta > 1)
+					cosTheta = 1;
+				else if (cosTheta < -1)
+					cosTheta = -1;
+				double err = fabs(acos(cosTheta) - EIGEN_PI / 2);
+				if (err > maxErr)
+					maxErr = err;
 			}
 		}
-
-		if (totalEnergy > 1.0e5) {
-			throw "Energy out of bounds";
-		}
-		return totalEnergy;
+		return maxErr;
 	}
 
 	double GridEnergy::calcTotalEnergy(const GridVert& vert) const {
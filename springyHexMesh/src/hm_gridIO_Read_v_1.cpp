@@ -88,6 +88,7 @@ namespace HexahedralMesher {
 		if (str != "REL:") return false;
 		for (int i = 0; i < 12; i++)
 			in >> _restEdgeLen[i];
+		clearEnergyCache();
 
 		in >> str;
 		if (str != "VI:") return false;
@@ -0,0 +1,66 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <iostream>
+
+#include <hm_gridBase.h>
+
+namespace HexahedralMesher {
+	using namespace std;
+
+	// Version 2 appends the split hierarchy to the version 1 layout
+	bool GridBase::readVersion2(istream& in) {
+		if (!readVersion1(in))
+			return false;
+
+		string str;
+		size_t numRecs;
+		in >> str >> numRecs;
+		if (str != "SplitHierarchy")
+			return false;
+
+		_splitHierarchy.resize(numRecs);
+		for (auto& rec : _splitHierarchy) {
+			in >> str;
+			if (str != "PC:") return false;
+			for (int i = 0; i < 8; i++)
+				in >> rec._parentCorners[i];
+
+			in >> str;
+			if (str != "CH:") return false;
+			for (int i = 0; i < 8; i++)
+				in >> rec._children[i];
+		}
+
+		return true;
+	}
+
+}
@@ -33,6 +33,7 @@ This file is part of the SpringHexMesh Project.
 #include <fstream>
 #include <iomanip>
 #include  <mutex>
+#include <atomic>
 
 #include <tm_math.h>
 #include <hm_gridVert.h>
@@ -45,6 +46,8 @@ namespace HexahedralMesher {
 	static const thread::id main_thread_id = this_thread::get_id();
 	thread_local int _thNum = 0;
 	thread_local int _thIdx = 0;
+	static atomic<size_t> gNextChangeNumber(1);
+	static atomic<size_t> gClampChangeNumber(0);
 
 	template<int NUM_THREADS>
 	void GridVertTempl<NUM_THREADS>::setThreadNumber(int threadNumber) {
@@ -59,6 +62,36 @@ namespace HexahedralMesher {
 		return _thNum;
 	}
 
+	template<int NUM_THREADS>
+	int GridVertTempl<NUM_THREADS>::getThreadIndex() {
+		return _thIdx;
+	}
+
+	template<int NUM_THREADS>
+	size_t GridVertTempl<NUM_THREADS>::nextChangeNumber() {
+		return gNextChangeNumber.fetch_add(1, memory_order_relaxed);
+	}
+
+	template<int NUM_THREADS>
+	size_t GridVertTempl<NUM_THREADS>::peekNextChangeNumber() {
+		return gNextChangeNumber.load(memory_order_relaxed);
+	}
+
+	template<int NUM_THREADS>
+	size_t GridVertTempl<NUM_THREADS>::getClampChangeNumber() {
+		return gClampChangeNumber.load(memory_order_relaxed);
+	}
+
+	template<int NUM_THREADS>
+	void GridVertTempl<NUM_THREADS>::clampTypeChanged() {
+		gClampChangeNumber.fetch_add(1, memory_order_relaxed);
+	}
+
+	template<int NUM_THREADS>
+	size_t GridVertTempl<NUM_THREADS>::getChangeNumber() const {
+		return _changeNumber[_thIdx];
+	}
+
 	template<int NUM_THREADS>
 	const Vector3d& GridVertTempl<NUM_THREADS>::getPt() const {
 		return _pt[_thIdx];
@@ -72,14 +105,27 @@ namespace HexahedralMesher {
 	template<int NUM_THREADS>
 	inline void GridVertTempl<NUM_THREADS>::setPoint(const Vector3d& pt) {
 		checkNAN(pt);
+		if (_pt[_thIdx] == pt)
+			return;
+		_pt[_thIdx] = pt;
+		_changeNumber[_thIdx] = nextChangeNumber();
+	}
+
+	template<int NUM_THREADS>
+	void GridVertTempl<NUM_THREADS>::restorePoint(const Vector3d& pt, size_t changeNumber) {
 		_pt[_thIdx] = pt;
-		_changeNumber++;
+		_changeNumber[_thIdx] = changeNumber;
 	}
 
 	template<int NUM_THREADS>
 	void GridVertTempl<NUM_THREADS>::setClamp(const GridBase& grid, const TopolRef& clamp) {
 		if (!clamp.verify(grid))
 			throw "Invald clamp";
+		if (_thIdx == 0) {
+			if (clamp.getClampType() != _clampTopol[0].getClampType())
+				clampTypeChanged();
+			grid.journalVert(_selfIndex);
+		}
 		_clampTopol[_thIdx] = clamp;
 	}
 
@@ -93,12 +139,21 @@ namespace HexahedralMesher {
 		for (int i = 1; i <= NUM_THREADS; i++) {
 			_pt[i] = _pt[0];
 			_clampTopol[i] = _clampTopol[0];
+			_changeNumber[i] = _changeNumber[0];
 		}
 	}
 
 	template<int NUM_THREADS>
 	void GridVertTempl<NUM_THREADS>::copyFromThread() {
-		_pt[0] = _stashPt;
+		if (_pt[0] != _stashPt) {
+			_pt[0] = _stashPt;
+			_changeNumber[0] = nextChangeNumber();
+		}
+		if (_stashClamp.getClampType() != _clampTopol[0].getClampType()) {
+			clampTypeChanged();
+			// Runs on the worker threads, so a new change number stands in for the verify journal
+			_changeNumber[0] = nextChangeNumber();
+		}
 		_clampTopol[0] = _stashClamp;
 	}
 
@@ -155,19 +210,39 @@ namespace HexahedralMesher {
 
 	template<int NUM_THREADS>
 	bool GridVertTempl<NUM_THREADS>::verify(const GridBase& grid, bool verifyCells) const {
+		string reason;
+		if (!verify(grid, reason))
+			return false;
+
+		if (verifyCells) {
+			for (size_t cellId : _cellIndices) {
+				if (!grid.getCell(cellId).verify(grid, false))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	template<int NUM_THREADS>
+	bool GridVertTempl<NUM_THREADS>::verify(const GridBase& grid, string& reason) const {
 		// Make sure the cells we reference reference this vert
 		for (size_t cellId : _cellIndices) {
-			if (!grid.cellExists(cellId))
+			if (!grid.cellExists(cellId)) {
+				reason = "links to deleted cell " + to_string(cellId);
 				return false;
+			}
 			const auto& cell = grid.getCell(cellId);
-			if (cell.getVertsPos(_selfIndex) == CVP_UNKNOWN)
-				return false;
-			if (verifyCells && !cell.verify(grid, false))
+			if (cell.getVertsPos(_selfIndex) == CVP_UNKNOWN) {
+				reason = "cell " + to_string(cellId) + " doesn't link back";
 				return false;
+			}
 		}
 
-		if (!_clampTopol->verify(grid))
+		if (!_clampTopol->verify(grid)) {
+			reason = "invalid clamp";
 			return false;
+		}
 
 		return true;
 	}
@@ -408,7 +483,7 @@ namespace HexahedralMesher {
 
 		_pt[0] = _pt[_thIdx];
 		_clampTopol[0] = _clampTopol[_thIdx];
-		_changeNumber++;
+		_changeNumber[0] = _changeNumber[_thIdx];
 
 #if LOG_HISTORY
 		{
@@ -423,6 +498,7 @@ namespace HexahedralMesher {
 		for (int i = 1; i < NUM_THREADS + 1; i++) {
 			_pt[i] = _pt[0];
 			_clampTopol[i] = _clampTopol[0];
+			_changeNumber[i] = _changeNumber[0];
 		}
 	}
 
@@ -459,14 +535,17 @@ namespace HexahedralMesher {
 		if (!_clampTopol[0].readVersion1(in)) return false;
 		for (auto& ct : _clampTopol)
 			ct = _clampTopol[0];
+		clampTypeChanged();
 
-		_changeNumber++;
+		size_t changeNumber = nextChangeNumber();
+		for (auto& cn : _changeNumber)
+			cn = changeNumber;
 
 		return true;
 	}
 
-	template class GridVertTempl<8>;
+	template class GridVertTempl<GRID_VERT_NUM_THREADS>;
 
-	template std::ostream& operator << (std::ostream& os, const GridVertTempl<8>& vert);
+	template std::ostream& operator << (std::ostream& os, const GridVertTempl<GRID_VERT_NUM_THREADS>& vert);
 
 }
@@ -0,0 +1,180 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <algorithm>
+
+#include <hm_laplacianSmoother.h>
+#include <hm_grid.h>
+#include <hm_tables.h>
+#include <hm_model.h>
+#include <meshProcessor.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	CLaplacianSmoother::CLaplacianSmoother(Grid& grid, int clampMask, int numThreads)
+		: _grid(grid)
+		, _clampMask(clampMask)
+		, _numThreads(numThreads)
+	{
+		_neighborStart.reserve(_grid.numVerts() + 1);
+		vector<size_t> verts;
+		for (size_t vertIdx = 0; vertIdx < _grid.numVerts(); vertIdx++) {
+			_neighborStart.push_back(_neighbors.size());
+
+			verts.clear();
+			for (size_t cellIdx : _grid.getVert(vertIdx).getCellIndices()) {
+				const auto& cell = _grid.getCell(cellIdx);
+				CellVertPos pos = cell.getVertsPos(vertIdx);
+				for (const auto& edgeEnd : gOrientedEdgePosLT[pos])
+					verts.push_back(cell.getVertIdx(edgeEnd.pos));
+			}
+			sort(verts.begin(), verts.end());
+			verts.erase(unique(verts.begin(), verts.end()), verts.end());
+			_neighbors.insert(_neighbors.end(), verts.begin(), verts.end());
+		}
+		_neighborStart.push_back(_neighbors.size());
+
+		_newPts.resize(_grid.numVerts());
+		_newClampIdx.resize(_grid.numVerts(), SIZE_MAX);
+	}
+
+	Vector3d CLaplacianSmoother::projectToClamp(size_t vertIdx, const Vector3d& delta, double maxMove, size_t& clampIdx) const {
+		clampIdx = SIZE_MAX;
+
+		// Projection onto a plane or line doesn't lengthen a move, so the linear clamps are limited after projecting
+		auto limit = [maxMove](const Vector3d& v)->Vector3d {
+			double len = v.norm();
+			return len > maxMove ? v * (maxMove / len) : v;
+		};
+
+		const TopolRef& clamp = _grid.getVert(vertIdx).getClamp();
+		switch (clamp.getClampType()) {
+		case CLAMP_NONE:
+			return limit(delta);
+		case CLAMP_PERPENDICULAR: {
+			const Vector3d& normal = clamp.getVector();
+			return limit(delta - normal * normal.dot(delta));
+		}
+		case CLAMP_GRID_TRI_PLANE: {
+			size_t triIdx[3];
+			clamp.getTriVertIndices(triIdx);
+			const Vector3d* triPts[3] = {
+				&_grid.getVert(triIdx[0]).getPrimaryPt(),
+				&_grid.getVert(triIdx[1]).getPrimaryPt(),
+				&_grid.getVert(triIdx[2]).getPrimaryPt(),
+			};
+			Vector3d normal = triangleNormal(triPts);
+			return limit(delta - normal * normal.dot(delta));
+		}
+		case CLAMP_PARALLEL: {
+			const Vector3d& dir = clamp.getVector();
+			return limit(dir * dir.dot(delta));
+		}
+		case CLAMP_TRI: {
+			const Vector3d& pt = _grid.getVert(vertIdx).getPrimaryPt();
+			return _grid.projectToSurface(vertIdx, pt + limit(delta), clampIdx) - pt;
+		}
+		case CLAMP_EDGE: {
+			// Slides along the polyline by the tangential part of the move
+			const auto& modelPtr = _grid.getMesher().getModelPtr(clamp.getMeshIdx());
+			const PolylineArcLength& arcLen = modelPtr->getPolylineArcLength(clamp.getPolylineNumber());
+			const Vector3d& pt = _grid.getVert(vertIdx).getPrimaryPt();
+			double s0 = arcLen.findArcLength(pt, clamp.getPolylineIndex());
+			double ds = arcLen.calcDir(s0).dot(delta);
+			ds = min(maxMove, max(-maxMove, ds));
+			double s = min(arcLen.getLength(), max(0.0, s0 + ds));
+			clampIdx = arcLen.findSegmentIndex(s);
+			return arcLen.calcPoint(s) - pt;
+		}
+		default:
+			// Model vertices stay in place, dependent vertices are repaired after the pass
+			return Vector3d(0, 0, 0);
+		}
+	}
+
+	double CLaplacianSmoother::smooth(int numPasses) {
+		const int movableMask = CLAMP_NONE | CLAMP_EDGE | CLAMP_TRI | CLAMP_PERPENDICULAR | CLAMP_PARALLEL | CLAMP_GRID_TRI_PLANE;
+
+		double maxMove = 0;
+		for (int pass = 0; pass < numPasses; pass++) {
+			_grid.iterateVerts([&](size_t vertIdx)->bool {
+				const auto& vert = _grid.getVert(vertIdx);
+				const Vector3d& pt = vert.getPrimaryPt();
+				_newPts[vertIdx] = pt;
+
+				size_t start = _neighborStart[vertIdx], end = _neighborStart[vertIdx + 1];
+				if (start == end || !vert.getClamp().matches(_clampMask & movableMask))
+					return true;
+
+				Vector3d avg(0, 0, 0);
+				double minEdgeLen = DBL_MAX;
+				for (size_t i = start; i < end; i++) {
+					const Vector3d& nbrPt = _grid.getVert(_neighbors[i]).getPrimaryPt();
+					avg += nbrPt;
+					minEdgeLen = min(minEdgeLen, (nbrPt - pt).norm());
+				}
+				avg /= (double)(end - start);
+
+				// Same move limit as the vertex minimizer
+				Vector3d delta = projectToClamp(vertIdx, _relaxation * (avg - pt), 0.25 * minEdgeLen, _newClampIdx[vertIdx]);
+				_newPts[vertIdx] = pt + delta;
+				return true;
+			}, _numThreads);
+
+			// setPoint from this thread writes the primary points
+			maxMove = 0;
+			for (size_t vertIdx = 0; vertIdx < _newPts.size(); vertIdx++) {
+				auto& vert = _grid.getVert(vertIdx);
+				double move = (_newPts[vertIdx] - vert.getPrimaryPt()).norm();
+				if (move > 0) {
+					// The clamp follows the vertex onto its new polyline segment or model triangle
+					size_t clampIdx = _newClampIdx[vertIdx];
+					auto& clamp = vert.getClamp();
+					if (clamp.matches(CLAMP_EDGE) && clampIdx != clamp.getPolylineIndex())
+						clamp.setPolylineIndex(clampIdx);
+					else if (clamp.matches(CLAMP_TRI) && clampIdx != clamp.getModelTriIdx())
+						clamp.setModelTriIdx(clampIdx);
+
+					vert.setPoint(_newPts[vertIdx]);
+					if (move > maxMove)
+						maxMove = move;
+				}
+			}
+
+			_grid.clampDependentVerts();
+		}
+
+		return maxMove;
+	}
+
+}
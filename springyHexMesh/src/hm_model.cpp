@@ -173,7 +173,15 @@ namespace HexahedralMesher {
 		findSharpEdges(sharps);
 		createPolylines(sharps);
 		createCuspsAndSplitPolylines();
+		createPolylineArcLengths();
+		_triangleBVH.build(*this);
+	}
 
+	void CModel::createPolylineArcLengths() {
+		_polylineArcLengths.clear();
+		_polylineArcLengths.reserve(_polyLines.size());
+		for (const auto& pl : _polyLines)
+			_polylineArcLengths.push_back(PolylineArcLength(*this, pl));
 	}
 
 	void CModel::save(ostream& out) const {
@@ -206,6 +214,8 @@ namespace HexahedralMesher {
 			if (!pl.read(in))
 				return false;
 		}
+		createPolylineArcLengths();
+		_triangleBVH.build(*this);
 
 		return true;
 	}
@@ -0,0 +1,207 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <set>
+
+#include <hm_multilevel.h>
+#include <hm_grid.h>
+#include <hm_gridCellEnergy.h>
+#include <hm_optimizer.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	namespace {
+		// CellVertPos bit 0 is x (left/right), bit 1 is y (front/back), bit 2 is z (lower/upper)
+		inline double trilinearWeight(int corner, const double param[3]) {
+			double result = 1;
+			for (int axis = 0; axis < 3; axis++)
+				result *= (corner & (1 << axis)) ? param[axis] : 1 - param[axis];
+			return result;
+		}
+	}
+
+	CMultilevel::CMultilevel(Grid& grid)
+		: _grid(grid)
+	{
+		build();
+	}
+
+	void CMultilevel::build() {
+		map<size_t, Prolongation> prolongMap;
+		for (const auto& rec : _grid.getSplitHierarchy()) {
+			if (!_grid.isSplitRecValid(rec))
+				continue;
+
+			for (int octant = 0; octant < 8; octant++) {
+				const auto& child = _grid.getCell(rec._children[octant]);
+				for (int childCorner = 0; childCorner < 8; childCorner++) {
+					// The child corner's parametric position in the parent is the average of the octant and corner positions
+					double param[3];
+					for (int axis = 0; axis < 3; axis++)
+						param[axis] = 0.5 * (((octant >> axis) & 1) + ((childCorner >> axis) & 1));
+
+					size_t fineVertIdx = child.getVertIdx((CellVertPos)childCorner);
+					for (int corner = 0; corner < 8; corner++) {
+						double w = trilinearWeight(corner, param);
+						if (w <= 0)
+							continue;
+						auto& prolong = prolongMap[rec._parentCorners[corner]];
+						// Trilinear interpolation is continuous across parents, so a shared vertex gets the same weight from each
+						prolong._fineWeights[fineVertIdx] = w;
+					}
+				}
+			}
+		}
+
+		const int movableMask = CLAMP_NONE | CLAMP_PERPENDICULAR | CLAMP_PARALLEL;
+		for (auto& iter : prolongMap) {
+			size_t vertIdx = iter.first;
+			if (!_grid.getVert(vertIdx).getClamp().matches(movableMask))
+				continue;
+
+			Prolongation& prolong = iter.second;
+			prolong._vertIdx = vertIdx;
+
+			set<size_t> cells;
+			for (const auto& fw : prolong._fineWeights) {
+				const auto& cellIndices = _grid.getVert(fw.first).getCellIndices();
+				cells.insert(cellIndices.begin(), cellIndices.end());
+			}
+			prolong._cells.insert(prolong._cells.end(), cells.begin(), cells.end());
+			_prolongations.push_back(prolong);
+		}
+	}
+
+	Vector3d CMultilevel::projectToClamp(size_t vertIdx, const Vector3d& delta) const {
+		const TopolRef& clamp = _grid.getVert(vertIdx).getClamp();
+		switch (clamp.getClampType()) {
+		case CLAMP_NONE:
+			return delta;
+		case CLAMP_PERPENDICULAR: {
+			const Vector3d& normal = clamp.getVector();
+			return delta - normal * normal.dot(delta);
+		}
+		case CLAMP_PARALLEL: {
+			const Vector3d& dir = clamp.getVector();
+			return dir * dir.dot(delta);
+		}
+		default:
+			// Vertices on model edges and vertices are left in place, dependent vertices are repaired after the sweep
+			return Vector3d(0, 0, 0);
+		}
+	}
+
+	double CMultilevel::calcEnergy(const Prolongation& prolong, const Vector3d& delta) const {
+		GridEnergy eCal(_grid, _grid.getEnergyParams());
+		double result = 0;
+		for (size_t cellIdx : prolong._cells) {
+			const auto& cell = _grid.getCell(cellIdx);
+			Vector3d pts[8];
+			for (int i = 0; i < 8; i++) {
+				size_t vertIdx = cell.getVertIdx((CellVertPos)i);
+				pts[i] = _grid.getVert(vertIdx).getPt();
+				auto iter = prolong._fineWeights.find(vertIdx);
+				if (iter != prolong._fineWeights.end())
+					pts[i] += iter->second * projectToClamp(vertIdx, delta);
+			}
+			result += eCal.calcTotalEnergy(cell, pts);
+		}
+		return result;
+	}
+
+	double CMultilevel::minimizeCoarseVertex(const Prolongation& prolong) {
+		auto& vert = _grid.getVert(prolong._vertIdx);
+		const int maxOptimizerSteps = 10;
+		const double differentialDist = 1.0e-8;
+		const double minEnergy = 1.0e-4;
+		// Coarse edges are twice the length of the fine edges around the vertex
+		const double maxMove = 0.5 * vert.findVertMinAdjEdgeLength(_grid);
+
+		Vector3d delta(0, 0, 0);
+		auto calFunc = [&](const Vector3d pts[], int numPts, double vals[]) {
+			for (int i = 0; i < numPts; i++)
+				vals[i] = calcEnergy(prolong, pts[i]);
+		};
+
+		auto gradFunc = [&](double dt, Vector3d& gradient, KnownValues& known)->double {
+			if (std::isnan(known._center))
+				known._center = calcEnergy(prolong, delta);
+			double e0 = known._center;
+			if (e0 <= 1.0e-6)
+				return 0;
+
+			for (int axis = 0; axis < 3; axis++) {
+				Vector3d d = delta;
+				d[axis] += dt;
+				gradient[axis] = (calcEnergy(prolong, d) - e0) / dt;
+			}
+			gradient = -projectToClamp(prolong._vertIdx, gradient);
+			double mag = gradient.norm();
+			if (mag < minNormalizeDivisor)
+				return 0;
+			gradient /= mag;
+			return DBL_MAX;
+		};
+
+		SteepestAcent<Vector3d> asc(minEnergy, differentialDist);
+		asc.run(delta, maxOptimizerSteps, maxMove, calFunc, gradFunc, [](int count, double moveDist) {});
+
+		double result = 0;
+		for (const auto& fw : prolong._fineWeights) {
+			auto& fineVert = _grid.getVert(fw.first);
+			Vector3d move = fw.second * projectToClamp(fw.first, delta);
+			if (move.norm() > result)
+				result = move.norm();
+			fineVert.setPoint(fineVert.getPt() + move);
+		}
+		return result;
+	}
+
+	double CMultilevel::coarseSweep(double& avgMove) {
+		double maxMove = 0;
+		avgMove = 0;
+		for (const auto& prolong : _prolongations) {
+			double move = minimizeCoarseVertex(prolong);
+			if (move > maxMove)
+				maxMove = move;
+			avgMove += move;
+		}
+
+		_grid.clampDependentVerts();
+
+		if (!_prolongations.empty())
+			avgMove /= _prolongations.size();
+		return maxMove;
+	}
+
+}
@@ -0,0 +1,288 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+
+#include <tm_defines.h>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <hm_optSchedule.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	namespace {
+		bool readMeshSolver(const string& str, MeshSolver& solver) {
+			for (MeshSolver s : { MS_VERTEX_SWEEP, MS_LBFGS, MS_FIRE, MS_PRIORITY }) {
+				if (str == COptSchedule::getMeshSolverStr(s)) {
+					solver = s;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool readVertexSolver(const string& str, VertexSolver& solver) {
+			for (VertexSolver s : { VS_STEEPEST_DESCENT, VS_NEWTON, VS_REDUCED }) {
+				if (str == COptSchedule::getVertexSolverStr(s)) {
+					solver = s;
+					return true;
+				}
+			}
+			return false;
+		}
+	}
+
+	COptSchedule::COptSchedule() {
+		Stage stage;
+
+		stage._name = "preFit";
+		stage._maxSweeps = 75;
+		setStage(stage);
+
+		stage._name = "polylineFit";
+		stage._maxSweeps = 50;
+		setStage(stage);
+
+		stage._name = "aligned";
+		stage._maxSweeps = 75;
+		setStage(stage);
+
+		stage._name = "divide";
+		stage._maxSweeps = 25;
+		setStage(stage);
+	}
+
+	bool COptSchedule::read(const string& path) {
+		ifstream in(path);
+		if (!in.good()) {
+			cout << "Could not open schedule " << path << "\n";
+			return false;
+		}
+		return read(in);
+	}
+
+	bool COptSchedule::read(istream& in) {
+		vector<Stage> stages;
+		bool inStage = false;
+		Stage stage;
+		string line;
+		int lineNum = 0;
+		while (getline(in, line)) {
+			lineNum++;
+			size_t pos = line.find('#');
+			if (pos != string::npos)
+				line.erase(pos);
+
+			istringstream ss(line);
+			string key;
+			if (!(ss >> key))
+				continue;
+
+			bool good = true;
+			if (key == "stage") {
+				stage = Stage();
+				good = !inStage && (ss >> stage._name);
+				inStage = true;
+			} else if (!inStage) {
+				good = false;
+			} else if (key == "end") {
+				stages.push_back(stage);
+				inStage = false;
+			} else if (key == "meshSolver") {
+				string str;
+				good = (ss >> str) && readMeshSolver(str, stage._meshSolver);
+				stage._overrides |= OVR_MESH_SOLVER;
+			} else if (key == "vertexSolver") {
+				string str;
+				good = (ss >> str) && readVertexSolver(str, stage._vertexSolver);
+				stage._overrides |= OVR_VERTEX_SOLVER;
+			} else if (key == "sweeps") {
+				good = (ss >> stage._maxSweeps) && stage._maxSweeps >= 0;
+			} else if (key == "seconds") {
+				good = (ss >> stage._maxSeconds) && stage._maxSeconds >= 0;
+			} else if (key == "moveTol") {
+				good = (bool)(ss >> stage._convergeMoveTol);
+				stage._overrides |= OVR_MOVE_TOL;
+			} else if (key == "energyTol") {
+				good = (bool)(ss >> stage._convergeEnergyTol);
+				stage._overrides |= OVR_ENERGY_TOL;
+			} else if (key == "kCompress") {
+				good = (bool)(ss >> stage._kCompress[0] >> stage._kCompress[1]);
+				stage._overrides |= OVR_K_COMPRESS;
+			} else if (key == "kBend") {
+				good = (bool)(ss >> stage._kBend[0] >> stage._kBend[1]);
+				stage._overrides |= OVR_K_BEND;
+			} else if (key == "continuationSteps") {
+				good = (ss >> stage._continuationSteps) && stage._continuationSteps >= 1;
+			} else if (key == "borrow") {
+				good = (ss >> stage._borrowFraction) && stage._borrowFraction >= 0;
+			} else
+				good = false;
+
+			if (!good) {
+				cout << "Bad schedule line " << lineNum << ": " << line << "\n";
+				return false;
+			}
+		}
+
+		if (inStage) {
+			cout << "Schedule stage " << stage._name << " has no end\n";
+			return false;
+		}
+
+		// Only replace the stages once the whole file has been read
+		for (const auto& s : stages)
+			setStage(s);
+		return true;
+	}
+
+	void COptSchedule::save(ostream& out) const {
+		for (const auto& stage : _stages) {
+			out << "stage " << stage._name << "\n";
+			if (stage._overrides & OVR_MESH_SOLVER)
+				out << "\tmeshSolver " << getMeshSolverStr(stage._meshSolver) << "\n";
+			if (stage._overrides & OVR_VERTEX_SOLVER)
+				out << "\tvertexSolver " << getVertexSolverStr(stage._vertexSolver) << "\n";
+			out << "\tsweeps " << stage._maxSweeps << "\n";
+			out << "\tseconds " << stage._maxSeconds << "\n";
+			if (stage._overrides & OVR_MOVE_TOL)
+				out << "\tmoveTol " << stage._convergeMoveTol << "\n";
+			if (stage._overrides & OVR_ENERGY_TOL)
+				out << "\tenergyTol " << stage._convergeEnergyTol << "\n";
+			if (stage._overrides & OVR_K_COMPRESS)
+				out << "\tkCompress " << stage._kCompress[0] << " " << stage._kCompress[1] << "\n";
+			if (stage._overrides & OVR_K_BEND)
+				out << "\tkBend " << stage._kBend[0] << " " << stage._kBend[1] << "\n";
+			out << "\tcontinuationSteps " << stage._continuationSteps << "\n";
+			out << "\tborrow " << stage._borrowFraction << "\n";
+			out << "end\n";
+		}
+	}
+
+	void COptSchedule::setStage(const Stage& stage) {
+		size_t idx = findStage(stage._name);
+		if (idx < _stages.size()) {
+			_stages[idx] = stage;
+			return;
+		}
+		_stages.push_back(stage);
+		_results.push_back(StageResult());
+	}
+
+	const COptSchedule::Stage& COptSchedule::getStage(const string& name) const {
+		size_t idx = findStage(name);
+		if (idx >= _stages.size())
+			throw "Unknown schedule stage";
+		return _stages[idx];
+	}
+
+	size_t COptSchedule::findStage(const string& name) const {
+		for (size_t i = 0; i < _stages.size(); i++) {
+			if (_stages[i]._name == name)
+				return i;
+		}
+		return stm1;
+	}
+
+	void COptSchedule::allocate(const string& name, int& sweeps, double& seconds) {
+		const Stage& stage = getStage(name);
+
+		int borrowSweeps = min(_sweepPool, (int)(stage._borrowFraction * stage._maxSweeps));
+		_sweepPool -= borrowSweeps;
+		sweeps = stage._maxSweeps + borrowSweeps;
+
+		// A stage without a time limit neither lends nor borrows time
+		seconds = 0;
+		if (stage._maxSeconds > 0) {
+			double borrowSeconds = min(_secondsPool, stage._borrowFraction * stage._maxSeconds);
+			_secondsPool -= borrowSeconds;
+			seconds = stage._maxSeconds + borrowSeconds;
+		}
+	}
+
+	void COptSchedule::reportResult(const string& name, const StageResult& result) {
+		size_t idx = findStage(name);
+		if (idx >= _stages.size())
+			throw "Unknown schedule stage";
+		_results[idx] = result;
+
+		// A stage which ran out of budget used all of it, including what it borrowed
+		if (!result._converged)
+			return;
+
+		_sweepPool += max(0, result._sweepsAllocated - result._sweepsUsed);
+		if (result._secondsAllocated > 0)
+			_secondsPool += max(0.0, result._secondsAllocated - result._secondsUsed);
+	}
+
+	void COptSchedule::resetPool() {
+		_sweepPool = 0;
+		_secondsPool = 0;
+	}
+
+	void COptSchedule::dumpResults(ostream& out) const {
+		out << "Schedule, pool: " << _sweepPool << " sweeps, " << _secondsPool << "s\n";
+		for (size_t i = 0; i < _stages.size(); i++) {
+			const auto& r = _results[i];
+			out << "  " << _stages[i]._name << ": " << r._sweepsUsed << "/" << r._sweepsAllocated << " sweeps, "
+				<< r._secondsUsed << "s" << (r._converged ? ", converged" : "") << "\n";
+		}
+	}
+
+	const char* COptSchedule::getMeshSolverStr(MeshSolver solver) {
+		switch (solver) {
+		case MS_VERTEX_SWEEP:
+			return "sweep";
+		case MS_LBFGS:
+			return "lbfgs";
+		case MS_FIRE:
+			return "fire";
+		case MS_PRIORITY:
+			return "priority";
+		}
+		return "unknown";
+	}
+
+	const char* COptSchedule::getVertexSolverStr(VertexSolver solver) {
+		switch (solver) {
+		case VS_STEEPEST_DESCENT:
+			return "steepest";
+		case VS_NEWTON:
+			return "newton";
+		case VS_REDUCED:
+			return "reduced";
+		}
+		return "unknown";
+	}
+
+}
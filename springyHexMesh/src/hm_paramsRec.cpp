@@ -30,6 +30,8 @@ This file is part of the SpringHexMesh Project.
 #include <tm_defines.h>
 
 #include <algorithm>
+#include <iomanip>
+#include <string>
 
 #include <hm_paramsRec.h>
 
@@ -53,12 +55,113 @@ namespace HexahedralMesher {
 		return (int)(l2 + 0.5);
 	}
 
-	void ParamsRec::save(ostream& out) const {
+	namespace {
+		template<class ENUM>
+		bool readEnum(istream& in, ENUM& val) {
+			int i;
+			if (!(in >> i))
+				return false;
+			val = (ENUM)i;
+			return true;
+		}
+	}
 
+	void ParamsRec::save(ostream& out) const {
+		out << "ParamsRec version 1\n";
+		out << fixed << setprecision(filePrecision);
+		out << "minEdgeLength " << minEdgeLength << "\n";
+		out << "minGapSize " << minGapSize << "\n";
+		out << "maxEdgeLength " << maxEdgeLength << "\n";
+		out << "sharpAngleDeg " << sharpAngleDeg << "\n";
+		out << "orthoModel " << (int)orthoModel << "\n";
+		out << "vertexSolver " << (int)vertexSolver << "\n";
+		out << "meshSolver " << (int)meshSolver << "\n";
+		out << "activeSet " << (activeSet ? 1 : 0) << "\n";
+		out << "preSmoothPasses " << preSmoothPasses << "\n";
+		out << "coarseSweeps " << coarseSweeps << "\n";
+		out << "priorityMaxSeconds " << priorityMaxSeconds << "\n";
+		out << "priorityMaxRelaxations " << priorityMaxRelaxations << "\n";
+		out << "sweepMaxSeconds " << sweepMaxSeconds << "\n";
+		out << "convergeMoveTol " << convergeMoveTol << "\n";
+		out << "convergeEnergyTol " << convergeEnergyTol << "\n";
+		out << "convergeWindow " << convergeWindow << "\n";
+		out << "kCompress " << kCompress << "\n";
+		out << "kBend " << kBend << "\n";
+		out << "validationTier " << (int)validationTier << "\n";
+		out << "validationSampleRate " << validationSampleRate << "\n";
+		const auto& bMin = bounds.getMin();
+		const auto& bMax = bounds.getMax();
+		out << "bounds " << bMin[0] << " " << bMin[1] << " " << bMin[2] << " " << bMax[0] << " " << bMax[1] << " " << bMax[2] << "\n";
+		out << "end\n";
 	}
 
 	bool ParamsRec::read(istream& in) {
-		return true;
+		string str0, str1;
+		int version;
+		in >> str0 >> str1 >> version;
+		if (str0 != "ParamsRec" || str1 != "version" || version != 1)
+			return false;
+
+		string key;
+		while (in >> key && key != "end") {
+			bool good = true;
+			if (key == "minEdgeLength")
+				good = (bool)(in >> minEdgeLength);
+			else if (key == "minGapSize")
+				good = (bool)(in >> minGapSize);
+			else if (key == "maxEdgeLength")
+				good = (bool)(in >> maxEdgeLength);
+			else if (key == "sharpAngleDeg")
+				good = (bool)(in >> sharpAngleDeg);
+			else if (key == "orthoModel")
+				good = readEnum(in, orthoModel);
+			else if (key == "vertexSolver")
+				good = readEnum(in, vertexSolver);
+			else if (key == "meshSolver")
+				good = readEnum(in, meshSolver);
+			else if (key == "activeSet") {
+				int val = 0;
+				good = (bool)(in >> val);
+				activeSet = val != 0;
+			} else if (key == "preSmoothPasses")
+				good = (bool)(in >> preSmoothPasses);
+			else if (key == "coarseSweeps")
+				good = (bool)(in >> coarseSweeps);
+			else if (key == "priorityMaxSeconds")
+				good = (bool)(in >> priorityMaxSeconds);
+			else if (key == "priorityMaxRelaxations")
+				good = (bool)(in >> priorityMaxRelaxations);
+			else if (key == "sweepMaxSeconds")
+				good = (bool)(in >> sweepMaxSeconds);
+			else if (key == "convergeMoveTol")
+				good = (bool)(in >> convergeMoveTol);
+			else if (key == "convergeEnergyTol")
+				good = (bool)(in >> convergeEnergyTol);
+			else if (key == "convergeWindow")
+				good = (bool)(in >> convergeWindow);
+			else if (key == "kCompress")
+				good = (bool)(in >> kCompress);
+			else if (key == "kBend")
+				good = (bool)(in >> kBend);
+			else if (key == "validationTier")
+				good = readEnum(in, validationTier);
+			else if (key == "validationSampleRate")
+				good = (bool)(in >> validationSampleRate);
+			else if (key == "bounds") {
+				Vector3d bMin, bMax;
+				good = (bool)(in >> bMin[0] >> bMin[1] >> bMin[2] >> bMax[0] >> bMax[1] >> bMax[2]);
+				bounds.clear();
+				bounds.merge(bMin);
+				bounds.merge(bMax);
+			} else {
+				// Written by a newer version, skip it
+				string rest;
+				getline(in, rest);
+			}
+			if (!good)
+				return false;
+		}
+		return key == "end";
 	}
 
 }
\ No newline at end of file
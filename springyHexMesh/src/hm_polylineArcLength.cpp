@@ -0,0 +1,213 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <algorithm>
+
+#include <hm_polylineArcLength.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	namespace {
+		const size_t maxLeafSegs = 4;
+
+		double calcBoxDistSqr(const Vector3d& boxMin, const Vector3d& boxMax, const Vector3d& pt) {
+			double result = 0;
+			for (int i = 0; i < 3; i++) {
+				double d = 0;
+				if (pt[i] < boxMin[i])
+					d = boxMin[i] - pt[i];
+				else if (pt[i] > boxMax[i])
+					d = pt[i] - boxMax[i];
+				result += d * d;
+			}
+			return result;
+		}
+	}
+
+	PolylineArcLength::PolylineArcLength(const TriMesh::CMesh& mesh, const TriMesh::CPolyLine& pl) {
+		size_t numSegs = pl.getVerts().size() - 1;
+		_segs.reserve(numSegs);
+		_segStart.reserve(numSegs + 1);
+		_segStart.push_back(0);
+		for (size_t i = 0; i < numSegs; i++) {
+			_segs.push_back(pl.getSegment(mesh, i));
+			_segStart.push_back(_segStart.back() + _segs.back().calLength());
+		}
+
+		_segOrder.resize(numSegs);
+		for (size_t i = 0; i < numSegs; i++)
+			_segOrder[i] = i;
+		if (numSegs > 0) {
+			_nodes.reserve(2 * numSegs / maxLeafSegs + 1);
+			buildNode(0, numSegs);
+		}
+	}
+
+	size_t PolylineArcLength::buildNode(size_t begin, size_t end) {
+		size_t nodeIdx = _nodes.size();
+		_nodes.push_back(Node());
+
+		Vector3d boxMin = Vector3d::Constant(DBL_MAX), boxMax = Vector3d::Constant(-DBL_MAX);
+		for (size_t i = begin; i < end; i++) {
+			const auto& seg = _segs[_segOrder[i]];
+			boxMin = boxMin.cwiseMin(seg._pts[0]).cwiseMin(seg._pts[1]);
+			boxMax = boxMax.cwiseMax(seg._pts[0]).cwiseMax(seg._pts[1]);
+		}
+
+		Node node;
+		node._min = boxMin;
+		node._max = boxMax;
+		if (end - begin <= maxLeafSegs) {
+			node._leaf = true;
+			node._left = begin;
+			node._right = end;
+		} else {
+			// Median split of the segment centers on the longest axis
+			int axis;
+			(boxMax - boxMin).maxCoeff(&axis);
+			size_t mid = (begin + end) / 2;
+			nth_element(_segOrder.begin() + begin, _segOrder.begin() + mid, _segOrder.begin() + end, [&](size_t a, size_t b) {
+				return _segs[a]._pts[0][axis] + _segs[a]._pts[1][axis] < _segs[b]._pts[0][axis] + _segs[b]._pts[1][axis];
+			});
+			node._leaf = false;
+			node._left = buildNode(begin, mid);
+			node._right = buildNode(mid, end);
+		}
+		_nodes[nodeIdx] = node;
+		return nodeIdx;
+	}
+
+	double PolylineArcLength::calcSegmentDist(size_t segIdx, const Vector3d& pt, double& t) const {
+		const auto& seg = _segs[segIdx];
+		double segLen = _segStart[segIdx + 1] - _segStart[segIdx];
+		t = 0;
+		if (segLen > minNormalizeDivisor) {
+			t = (pt - seg._pts[0]).dot(seg._pts[1] - seg._pts[0]) / (segLen * segLen);
+			t = std::min(1.0, std::max(0.0, t));
+		}
+		return (seg.interpolate(t) - pt).norm();
+	}
+
+	void PolylineArcLength::searchNode(size_t nodeIdx, const Vector3d& pt, size_t& bestIdx, double& bestDist, double& bestT) const {
+		const auto& node = _nodes[nodeIdx];
+		if (calcBoxDistSqr(node._min, node._max, pt) >= bestDist * bestDist)
+			return;
+
+		if (node._leaf) {
+			for (size_t i = node._left; i < node._right; i++) {
+				size_t segIdx = _segOrder[i];
+				double t, dist = calcSegmentDist(segIdx, pt, t);
+				if (dist < bestDist || (dist == bestDist && segIdx < bestIdx)) {
+					bestIdx = segIdx;
+					bestDist = dist;
+					bestT = t;
+				}
+			}
+			return;
+		}
+
+		// Nearer child first, so the bound tightens before the other is tested
+		size_t first = node._left, second = node._right;
+		if (calcBoxDistSqr(_nodes[second]._min, _nodes[second]._max, pt) < calcBoxDistSqr(_nodes[first]._min, _nodes[first]._max, pt))
+			swap(first, second);
+		searchNode(first, pt, bestIdx, bestDist, bestT);
+		searchNode(second, pt, bestIdx, bestDist, bestT);
+	}
+
+	bool PolylineArcLength::findClosestPoint(const Vector3d& pt, size_t hintIdx, size_t& segIdx, double& dist, double& t) const {
+		segIdx = 0;
+		dist = DBL_MAX;
+		t = 0;
+		if (_segs.empty())
+			return false;
+
+		// The hint and its neighbors bound the search
+		if (hintIdx < _segs.size()) {
+			size_t first = hintIdx > 0 ? hintIdx - 1 : 0;
+			size_t last = std::min(hintIdx + 2, _segs.size());
+			for (size_t i = first; i < last; i++) {
+				double segT, segDist = calcSegmentDist(i, pt, segT);
+				if (segDist < dist) {
+					segIdx = i;
+					dist = segDist;
+					t = segT;
+				}
+			}
+			// Slightly looser, so an equally close segment elsewhere is still found
+			dist = std::nextafter(dist, DBL_MAX);
+		}
+		searchNode(0, pt, segIdx, dist, t);
+		dist = calcSegmentDist(segIdx, pt, t);
+
+		// Off the ends, report the parameter on the end segment's line
+		const auto& seg = _segs[segIdx];
+		double segLen = _segStart[segIdx + 1] - _segStart[segIdx];
+		if (segLen > minNormalizeDivisor && ((segIdx == 0 && t == 0) || (segIdx == _segs.size() - 1 && t == 1)))
+			t = (pt - seg._pts[0]).dot(seg._pts[1] - seg._pts[0]) / (segLen * segLen);
+
+		return dist <= SAME_DIST_TOL;
+	}
+
+	double PolylineArcLength::findArcLength(const Vector3d& pt, size_t hintIdx) const {
+		size_t segIdx;
+		double dist, t;
+		findClosestPoint(pt, hintIdx, segIdx, dist, t);
+		t = std::min(1.0, std::max(0.0, t));
+		return _segStart[segIdx] + t * (_segStart[segIdx + 1] - _segStart[segIdx]);
+	}
+
+	size_t PolylineArcLength::findSegmentIndex(double s) const {
+		size_t idx = upper_bound(_segStart.begin(), _segStart.end(), s) - _segStart.begin();
+		idx = idx > 0 ? idx - 1 : 0;
+		return idx < _segs.size() ? idx : _segs.size() - 1;
+	}
+
+	Vector3d PolylineArcLength::calcPoint(double s) const {
+		size_t idx = findSegmentIndex(s);
+		double segLen = _segStart[idx + 1] - _segStart[idx];
+		if (segLen < minNormalizeDivisor)
+			return _segs[idx]._pts[0];
+		return _segs[idx].interpolate((s - _segStart[idx]) / segLen);
+	}
+
+	Vector3d PolylineArcLength::calcDir(double s) const {
+		size_t idx = findSegmentIndex(s);
+		const auto& seg = _segs[idx];
+		Vector3d dir = seg._pts[1] - seg._pts[0];
+		double len = dir.norm();
+		if (len < minNormalizeDivisor)
+			return Vector3d(0, 0, 0);
+		return dir / len;
+	}
+
+}
@@ -109,15 +109,21 @@ namespace HexahedralMesher {
 		splitCellFullInit(cellIdx);
 		SplitSourceRec& splitRec = createOctSplit(cellIdx);
 
-		addSubCellLwrFntLft(splitRec);
-		addSubCellLwrFntRgt(splitRec);
-		addSubCellLwrBckLft(splitRec);
-		addSubCellLwrBckRgt(splitRec);
-
-		addSubCellUprFntLft(splitRec);
-		addSubCellUprFntRgt(splitRec);
-		addSubCellUprBckLft(splitRec);
-		addSubCellUprBckRgt(splitRec);
+		GridBase::CellSplitRec hierRec;
+		for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++)
+			hierRec._parentCorners[p] = _workCell.getVertIdx(p);
+
+		hierRec._children[LWR_FNT_LFT] = addSubCellLwrFntLft(splitRec);
+		hierRec._children[LWR_FNT_RGT] = addSubCellLwrFntRgt(splitRec);
+		hierRec._children[LWR_BCK_LFT] = addSubCellLwrBckLft(splitRec);
+		hierRec._children[LWR_BCK_RGT] = addSubCellLwrBckRgt(splitRec);
+
+		hierRec._children[UPR_FNT_LFT] = addSubCellUprFntLft(splitRec);
+		hierRec._children[UPR_FNT_RGT] = addSubCellUprFntRgt(splitRec);
+		hierRec._children[UPR_BCK_LFT] = addSubCellUprBckLft(splitRec);
+		hierRec._children[UPR_BCK_RGT] = addSubCellUprBckRgt(splitRec);
+
+		_grid.addSplitRec(hierRec);
 	}
 
 	void CSplitter::clear() {
@@ -164,7 +170,7 @@ namespace HexahedralMesher {
 	}
 
 	void CSplitter::fixBrokenLinks() {
-		_grid.iterateVerts([&](size_t vertIdx)->bool {
+		_grid.iterateVertsOfType(CLAMP_CELL_EDGE_CENTER, [&](size_t vertIdx)->bool {
 			auto& vert = getVert(vertIdx);
 			auto& clamp = vert.getClamp();
 			switch (vert.getClampType()) {
@@ -263,8 +269,8 @@ namespace HexahedralMesher {
 		size_t cellIdx = _grid.addCell(cell);
 		splitRec.addChild(cellIdx);
 		_newCells.push_back(cellIdx);
-		if (!getCell(cellIdx).verify(_grid, true)) {
-			getCell(cellIdx).verify(_grid, true);
+		// GridBase::addCell has checked the cell at the grid's tier, this repeats it only for VT_PARANOID
+		if (_grid.getValidationTier() == VT_PARANOID && !getCell(cellIdx).verify(_grid, true)) {
 			cout << "Divided cell failed verification.\n";
 		}
 		return cellIdx;
@@ -544,13 +550,12 @@ for (int i = 0; i < 12; i++) \
 		newCell.setDefaultRestEdgeLengths(_grid);
 
 		size_t cellIdx = addCell(newCell, splitRec);
-#if 1
-		const auto& cell = getCell(cellIdx);
-		if (!cell.verify(_grid, true)) {
-			cell.verify(_grid, true);
-			throw "Bad cell";
+		if (_grid.getValidationTier() == VT_PARANOID) {
+			const auto& cell = getCell(cellIdx);
+			if (!cell.verify(_grid, true)) {
+				throw "Bad cell";
+			}
 		}
-#endif
 		return cellIdx;
 	}
 
@@ -1075,15 +1080,15 @@ for (int i = 0; i < 12; i++) \
 
 		const auto& mesher = _grid.getMesher();
 		const auto& modelPtr = mesher.getModelPtr(meshIdx);
-		const auto& pl = modelPtr->_polyLines[polylineNum];
+		const auto& arcLen = modelPtr->getPolylineArcLength(polylineNum);
 		size_t plIdx;
 		double d, t;
-		pl.findClosestPointOnPolyline(*modelPtr, pt, plIdx, d, t);
+		arcLen.findClosestPoint(pt, SIZE_MAX, plIdx, d, t);
 		if (d < minDist) {
 			minDist = d;
 			bestPolylineNum = polylineNum;
 			bestPolylineIndex = plIdx;
-			LineSegment seg = pl.getSegment(*modelPtr, plIdx);
+			const LineSegment& seg = arcLen.getSegment(plIdx);
 			if (t < 0)
 				bestPt = seg._pts[0];
 			else if (t > 1)
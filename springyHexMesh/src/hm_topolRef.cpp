@@ -94,6 +94,12 @@ namespace HexahedralMesher {
 			const auto& pl = modelPtr->_polyLines[getPolylineNumber()];
 			return pl.isValidIndex(getPolylineIndex());
 		}
+		case CLAMP_TRI: {
+			const auto& mesher = grid.getMesher();
+			if (!mesher.modelExists(getMeshIdx()))
+				return false;
+			return getModelTriIdx() < mesher.getModelPtr(getMeshIdx())->numTris();
+		}
 		default:
 			break;
 		}
@@ -0,0 +1,281 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+
+#include <tm_defines.h>
+
+#include <algorithm>
+
+#include <hm_triangleBVH.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	namespace {
+		const size_t maxLeafTris = 4;
+
+		double calcBoxDistSqr(const Vector3d& boxMin, const Vector3d& boxMax, const Vector3d& pt) {
+			double result = 0;
+			for (int i = 0; i < 3; i++) {
+				double d = 0;
+				if (pt[i] < boxMin[i])
+					d = boxMin[i] - pt[i];
+				else if (pt[i] > boxMax[i])
+					d = pt[i] - boxMax[i];
+				result += d * d;
+			}
+			return result;
+		}
+
+		// Slab test, returns the entry distance or DBL_MAX for a miss
+		double calcBoxRayDist(const Vector3d& boxMin, const Vector3d& boxMax, const Vector3d& origin, const Vector3d& dir) {
+			double tMin = 0, tMax = DBL_MAX;
+			for (int i = 0; i < 3; i++) {
+				if (fabs(dir[i]) < minNormalizeDivisor) {
+					if (origin[i] < boxMin[i] || origin[i] > boxMax[i])
+						return DBL_MAX;
+					continue;
+				}
+				double t0 = (boxMin[i] - origin[i]) / dir[i];
+				double t1 = (boxMax[i] - origin[i]) / dir[i];
+				if (t0 > t1)
+					swap(t0, t1);
+				tMin = std::max(tMin, t0);
+				tMax = std::min(tMax, t1);
+				if (tMin > tMax)
+					return DBL_MAX;
+			}
+			return tMin;
+		}
+
+		// Closest point on a triangle, from the Voronoi regions of its vertices and edges
+		Vector3d closestPointOnTri(const Vector3d& pt, const Vector3d& a, const Vector3d& b, const Vector3d& c) {
+			Vector3d ab = b - a, ac = c - a, ap = pt - a;
+			double d1 = ab.dot(ap), d2 = ac.dot(ap);
+			if (d1 <= 0 && d2 <= 0)
+				return a;
+
+			Vector3d bp = pt - b;
+			double d3 = ab.dot(bp), d4 = ac.dot(bp);
+			if (d3 >= 0 && d4 <= d3)
+				return b;
+
+			double vc = d1 * d4 - d3 * d2;
+			if (vc <= 0 && d1 >= 0 && d3 <= 0)
+				return a + ab * (d1 / (d1 - d3));
+
+			Vector3d cp = pt - c;
+			double d5 = ab.dot(cp), d6 = ac.dot(cp);
+			if (d6 >= 0 && d5 <= d6)
+				return c;
+
+			double vb = d5 * d2 - d1 * d6;
+			if (vb <= 0 && d2 >= 0 && d6 <= 0)
+				return a + ac * (d2 / (d2 - d6));
+
+			double va = d3 * d6 - d5 * d4;
+			if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+				return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+			double denom = va + vb + vc;
+			if (fabs(denom) < minNormalizeDivisor)
+				return a;
+			return a + ab * (vb / denom) + ac * (vc / denom);
+		}
+	}
+
+	void CTriangleBVH::build(const TriMesh::CMesh& mesh) {
+		size_t numTris = mesh.numTris();
+		_triPts.clear();
+		_triNormals.clear();
+		_nodes.clear();
+		_triPts.reserve(3 * numTris);
+		_triNormals.reserve(numTris);
+		for (size_t triIdx = 0; triIdx < numTris; triIdx++) {
+			const size_t* vertIndices = mesh.getTri(triIdx);
+			const Vector3d* pts[3];
+			for (int i = 0; i < 3; i++) {
+				_triPts.push_back(mesh.getVert(vertIndices[i])._pt);
+				pts[i] = &mesh.getVert(vertIndices[i])._pt;
+			}
+			_triNormals.push_back(triangleNormal(pts));
+		}
+
+		_triOrder.resize(numTris);
+		for (size_t i = 0; i < numTris; i++)
+			_triOrder[i] = i;
+		if (numTris > 0) {
+			_nodes.reserve(2 * numTris / maxLeafTris + 1);
+			buildNode(0, numTris);
+		}
+	}
+
+	size_t CTriangleBVH::buildNode(size_t begin, size_t end) {
+		size_t nodeIdx = _nodes.size();
+		_nodes.push_back(Node());
+
+		Vector3d boxMin = Vector3d::Constant(DBL_MAX), boxMax = Vector3d::Constant(-DBL_MAX);
+		for (size_t i = begin; i < end; i++) {
+			const Vector3d* pts = &_triPts[3 * _triOrder[i]];
+			for (int j = 0; j < 3; j++) {
+				boxMin = boxMin.cwiseMin(pts[j]);
+				boxMax = boxMax.cwiseMax(pts[j]);
+			}
+		}
+
+		Node node;
+		node._min = boxMin;
+		node._max = boxMax;
+		if (end - begin <= maxLeafTris) {
+			node._leaf = true;
+			node._left = begin;
+			node._right = end;
+		} else {
+			// Median split of the triangle centroids on the longest axis
+			int axis;
+			(boxMax - boxMin).maxCoeff(&axis);
+			size_t mid = (begin + end) / 2;
+			auto centroidSum = [&](size_t triIdx) {
+				const Vector3d* pts = &_triPts[3 * triIdx];
+				return pts[0][axis] + pts[1][axis] + pts[2][axis];
+			};
+			nth_element(_triOrder.begin() + begin, _triOrder.begin() + mid, _triOrder.begin() + end, [&](size_t a, size_t b) {
+				return centroidSum(a) < centroidSum(b);
+			});
+			node._leaf = false;
+			node._left = buildNode(begin, mid);
+			node._right = buildNode(mid, end);
+		}
+		_nodes[nodeIdx] = node;
+		return nodeIdx;
+	}
+
+	double CTriangleBVH::calcTriDistSqr(size_t triIdx, const Vector3d& pt, Vector3d& closestPt) const {
+		const Vector3d* pts = &_triPts[3 * triIdx];
+		closestPt = closestPointOnTri(pt, pts[0], pts[1], pts[2]);
+		return (closestPt - pt).squaredNorm();
+	}
+
+	void CTriangleBVH::searchNode(size_t nodeIdx, const Vector3d& pt, size_t& bestIdx, double& bestDistSqr, Vector3d& bestPt) const {
+		const auto& node = _nodes[nodeIdx];
+		if (calcBoxDistSqr(node._min, node._max, pt) >= bestDistSqr)
+			return;
+
+		if (node._leaf) {
+			for (size_t i = node._left; i < node._right; i++) {
+				size_t triIdx = _triOrder[i];
+				Vector3d closestPt;
+				double distSqr = calcTriDistSqr(triIdx, pt, closestPt);
+				if (distSqr < bestDistSqr) {
+					bestIdx = triIdx;
+					bestDistSqr = distSqr;
+					bestPt = closestPt;
+				}
+			}
+			return;
+		}
+
+		// Nearer child first, so the bound tightens before the other is tested
+		size_t first = node._left, second = node._right;
+		if (calcBoxDistSqr(_nodes[second]._min, _nodes[second]._max, pt) < calcBoxDistSqr(_nodes[first]._min, _nodes[first]._max, pt))
+			swap(first, second);
+		searchNode(first, pt, bestIdx, bestDistSqr, bestPt);
+		searchNode(second, pt, bestIdx, bestDistSqr, bestPt);
+	}
+
+	bool CTriangleBVH::findClosestPoint(const Vector3d& pt, size_t hintTri, size_t& triIdx, Vector3d& closestPt, double& dist) const {
+		triIdx = SIZE_MAX;
+		dist = DBL_MAX;
+		if (_nodes.empty())
+			return false;
+
+		double bestDistSqr = DBL_MAX;
+		if (hintTri < numTris()) {
+			// Slightly looser than the hint's distance, so the hint is kept unless another triangle is closer
+			triIdx = hintTri;
+			bestDistSqr = std::nextafter(calcTriDistSqr(hintTri, pt, closestPt), DBL_MAX);
+		}
+		searchNode(0, pt, triIdx, bestDistSqr, closestPt);
+
+		dist = (closestPt - pt).norm();
+		return true;
+	}
+
+	bool CTriangleBVH::rayCast(const Vector3d& origin, const Vector3d& dir, size_t& triIdx, double& dist) const {
+		triIdx = SIZE_MAX;
+		dist = DBL_MAX;
+		if (_nodes.empty())
+			return false;
+
+		// Depth first, skipping nodes entered beyond the closest hit so far
+		thread_local vector<size_t> stack;
+		stack.clear();
+		stack.push_back(0);
+		while (!stack.empty()) {
+			const auto& node = _nodes[stack.back()];
+			stack.pop_back();
+			if (calcBoxRayDist(node._min, node._max, origin, dir) >= dist)
+				continue;
+
+			if (!node._leaf) {
+				stack.push_back(node._left);
+				stack.push_back(node._right);
+				continue;
+			}
+
+			for (size_t i = node._left; i < node._right; i++) {
+				// Moller-Trumbore
+				size_t idx = _triOrder[i];
+				const Vector3d* pts = &_triPts[3 * idx];
+				Vector3d e1 = pts[1] - pts[0], e2 = pts[2] - pts[0];
+				Vector3d p = dir.cross(e2);
+				double det = e1.dot(p);
+				if (fabs(det) < minNormalizeDivisor)
+					continue;
+				Vector3d s = origin - pts[0];
+				double u = s.dot(p) / det;
+				if (u < 0 || u > 1)
+					continue;
+				Vector3d q = s.cross(e1);
+				double v = dir.dot(q) / det;
+				if (v < 0 || u + v > 1)
+					continue;
+				double t = e2.dot(q) / det;
+				if (t >= 0 && t < dist) {
+					triIdx = idx;
+					dist = t;
+				}
+			}
+		}
+
+		return triIdx != SIZE_MAX;
+	}
+
+}
@@ -92,5 +92,16 @@ namespace HexahedralMesher {
 		return in;
 	}
 
+	void calcTangentAxes(const Vector3d& normal, Vector3d& xAxis, Vector3d& yAxis) {
+		xAxis = vX;
+		if (fabs(xAxis.dot(normal)) > 0.7071) {
+			xAxis = vY;
+			if (fabs(xAxis.dot(normal)) > 0.7071) {
+				xAxis = vZ;
+			}
+		}
+		xAxis = (xAxis - normal * normal.dot(xAxis)).normalized();
+		yAxis = normal.cross(xAxis);
+	}
 
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+
+#include <tm_defines.h>
+
+#include <algorithm>
+
+#include <hm_verifyReport.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	namespace {
+		// Errors ahead of warnings, then by entity
+		bool entryLess(const VerifyReport::Entry& lhs, const VerifyReport::Entry& rhs) {
+			if (lhs._isError != rhs._isError)
+				return lhs._isError;
+			int cmp = string(lhs._entityType).compare(rhs._entityType);
+			if (cmp != 0)
+				return cmp < 0;
+			return lhs._idx < rhs._idx;
+		}
+	}
+
+	VerifyReport::VerifyReport(size_t maxEntries)
+		: _maxEntries(maxEntries)
+	{
+	}
+
+	void VerifyReport::addError(const char* entityType, size_t idx, const string& reason) {
+		add(true, entityType, idx, reason);
+	}
+
+	void VerifyReport::addWarning(const char* entityType, size_t idx, const string& reason) {
+		add(false, entityType, idx, reason);
+	}
+
+	void VerifyReport::add(bool isError, const char* entityType, size_t idx, const string& reason) {
+		lock_guard<mutex> lock(_mutex);
+		if (isError)
+			_numErrors++;
+		else
+			_numWarnings++;
+
+		Entry entry = { isError, entityType, idx, reason };
+		if (_entries.size() < _maxEntries) {
+			_entries.push_back(entry);
+			return;
+		}
+
+		// Keep the first entries in entryLess order, so the kept set doesn't depend on which thread got there first
+		auto iter = max_element(_entries.begin(), _entries.end(), entryLess);
+		if (entryLess(entry, *iter))
+			*iter = entry;
+	}
+
+	bool VerifyReport::passed() const {
+		lock_guard<mutex> lock(_mutex);
+		return _numErrors == 0;
+	}
+
+	bool VerifyReport::empty() const {
+		lock_guard<mutex> lock(_mutex);
+		return _numErrors == 0 && _numWarnings == 0;
+	}
+
+	size_t VerifyReport::numErrors() const {
+		lock_guard<mutex> lock(_mutex);
+		return _numErrors;
+	}
+
+	size_t VerifyReport::numWarnings() const {
+		lock_guard<mutex> lock(_mutex);
+		return _numWarnings;
+	}
+
+	vector<VerifyReport::Entry> VerifyReport::getEntries() const {
+		lock_guard<mutex> lock(_mutex);
+		vector<Entry> result(_entries);
+		sort(result.begin(), result.end(), entryLess);
+		return result;
+	}
+
+	void VerifyReport::dump(ostream& out) const {
+		vector<Entry> entries = getEntries();
+		out << "Verify: " << numErrors() << " errors, " << numWarnings() << " warnings\n";
+		for (const auto& entry : entries)
+			out << "  " << (entry._isError ? "Error" : "Warning") << " " << entry._entityType << " " << entry._idx << ": " << entry._reason << "\n";
+		if (entries.size() < numErrors() + numWarnings())
+			out << "  ...\n";
+	}
+
+}
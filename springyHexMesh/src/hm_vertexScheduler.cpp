@@ -0,0 +1,199 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+#include <tm_defines.h>
+
+#include <chrono>
+
+#include <hm_vertexScheduler.h>
+#include <hm_grid.h>
+#include <hm_gridCellEnergy.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	CVertexScheduler::CVertexScheduler(Grid& grid, int clampMask, int numThreads)
+		: _grid(grid)
+		, _clampMask(clampMask)
+		, _numThreads(numThreads)
+		, _minEnergy(1.0e-4)
+	{
+		_vertBucket.resize(_grid.numVerts(), -1);
+		_mark.resize(_grid.numVerts(), 0);
+
+		vector<size_t> allVerts(_grid.numVerts());
+		for (size_t i = 0; i < allVerts.size(); i++)
+			allVerts[i] = i;
+
+		_grid.iterateVertList(allVerts, [&](size_t vertIdx)->bool {
+			push(vertIdx, calcPrimaryVertexEnergy(vertIdx));
+			return true;
+		}, _numThreads);
+	}
+
+	size_t CVertexScheduler::numQueued() const {
+		size_t result = 0;
+		for (int vb : _vertBucket) {
+			if (vb != -1)
+				result++;
+		}
+		return result;
+	}
+
+	int CVertexScheduler::calcBucket(double energy) const {
+		// Two buckets per doubling of the energy
+		int result = (int)(2 * log2(energy / _minEnergy));
+		if (result < 0)
+			return 0;
+		if (result >= NUM_BUCKETS)
+			return NUM_BUCKETS - 1;
+		return result;
+	}
+
+	void CVertexScheduler::push(size_t vertIdx, double energy) {
+		// Each vertex is pushed by one thread per round, so _vertBucket[vertIdx] isn't shared
+		const int movableMask = CLAMP_NONE | CLAMP_EDGE | CLAMP_TRI | CLAMP_PERPENDICULAR | CLAMP_PARALLEL | CLAMP_GRID_TRI_PLANE;
+		if (energy < _minEnergy || !_grid.getVert(vertIdx).getClamp().matches(_clampMask & movableMask)) {
+			_vertBucket[vertIdx] = -1;
+			return;
+		}
+
+		int bucketIdx = calcBucket(energy);
+		_vertBucket[vertIdx] = bucketIdx;
+
+		auto& bucket = _buckets[bucketIdx];
+		lock_guard<mutex> lock(bucket._mutex);
+		bucket._verts.push_back(vertIdx);
+	}
+
+	size_t CVertexScheduler::popBatch(size_t maxCount, vector<size_t>& batch) {
+		batch.clear();
+		for (int bucketIdx = NUM_BUCKETS - 1; bucketIdx >= 0 && batch.size() < maxCount; bucketIdx--) {
+			auto& verts = _buckets[bucketIdx]._verts;
+			while (!verts.empty() && batch.size() < maxCount) {
+				size_t vertIdx = verts.back();
+				verts.pop_back();
+				if (_vertBucket[vertIdx] != bucketIdx)
+					continue;
+				_vertBucket[vertIdx] = -1;
+				batch.push_back(vertIdx);
+			}
+		}
+		return batch.size();
+	}
+
+	void CVertexScheduler::findStencil(const vector<size_t>& batch, vector<size_t>& stencil) {
+		stencil.clear();
+		for (size_t vertIdx : batch) {
+			for (size_t cellIdx : _grid.getVert(vertIdx).getCellIndices()) {
+				const auto& cell = _grid.getCell(cellIdx);
+				for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++) {
+					size_t idx = cell.getVertIdx(p);
+					if (!_mark[idx]) {
+						_mark[idx] = 1;
+						stencil.push_back(idx);
+					}
+				}
+			}
+		}
+		for (size_t idx : stencil)
+			_mark[idx] = 0;
+	}
+
+	double CVertexScheduler::calcPrimaryVertexEnergy(size_t vertIdx) const {
+		// Reads the primary points and never the energy cache, so it's safe from any thread between rounds
+		GridEnergy eCal(_grid, _grid.getEnergyParams());
+		double result = 0;
+		for (size_t cellIdx : _grid.getVert(vertIdx).getCellIndices()) {
+			const auto& cell = _grid.getCell(cellIdx);
+			Vector3d pts[8];
+			for (int i = 0; i < 8; i++)
+				pts[i] = _grid.getVert(cell.getVertIdx((CellVertPos)i)).getPrimaryPt();
+			result += eCal.calcTotalEnergy(cell, pts);
+		}
+		return result;
+	}
+
+	size_t CVertexScheduler::run(double maxSeconds, size_t maxRelaxations, ostream& logOut) {
+		const size_t batchSize = 64 * (size_t)_numThreads;
+		auto startTime = chrono::steady_clock::now();
+
+		size_t numRelaxations = 0;
+		vector<size_t> batch, stencil;
+		while (popBatch(batchSize, batch) > 0) {
+			findStencil(batch, stencil);
+			// Only the stencil's tri plane frames can be stale, a full refresh per batch would make a sweep quadratic
+			_grid.updateConstraintFrames(stencil);
+
+			// The batch reads its neighbors from the thread copies, refresh them
+			_grid.iterateVertList(stencil, [&](size_t vertIdx)->bool {
+				_grid.getVert(vertIdx).copyToThread();
+				return true;
+			}, _numThreads);
+
+			_grid.iterateVertList(batch, [&](size_t vertIdx)->bool {
+				_grid.minimizeVertexEnergy(logOut, vertIdx, _clampMask);
+				return true;
+			}, _numThreads);
+
+			_grid.iterateVertList(batch, [&](size_t vertIdx)->bool {
+				_grid.getVert(vertIdx).copyFromThread();
+				return true;
+			}, _numThreads);
+
+			if (_grid.hasDependentVerts()) {
+				// The batch's dependents, including dependents of dependents, then the tri plane vertices next to it
+				_grid.clampDependentVerts(batch, stencil);
+			} else {
+				// Same order as Grid::clampDependentVerts, limited to the stencil. A dependent vertex shares a cell with the vertex it depends on.
+				for (size_t vertIdx : stencil)
+					_grid.clampVertexToCellEdgeCenter(vertIdx);
+				for (size_t vertIdx : stencil)
+					_grid.clampVertexToCellFaceCenter(vertIdx);
+				for (size_t vertIdx : stencil)
+					_grid.clampVertexToTriPlane(vertIdx);
+			}
+
+			_grid.iterateVertList(stencil, [&](size_t vertIdx)->bool {
+				push(vertIdx, calcPrimaryVertexEnergy(vertIdx));
+				return true;
+			}, _numThreads);
+
+			numRelaxations += batch.size();
+			if (maxRelaxations > 0 && numRelaxations >= maxRelaxations)
+				break;
+			if (maxSeconds > 0 && chrono::duration<double>(chrono::steady_clock::now() - startTime).count() >= maxSeconds)
+				break;
+		}
+
+		return numRelaxations;
+	}
+
+}
@@ -0,0 +1,302 @@
+/*
+
+This file is part of the SpringHexMesh Project.
+
+	The SpringHexMesh Project is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	The SpringHexMesh Project is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This link provides the exact terms of the GPL license <https://www.gnu.org/licenses/>.
+
+	The author's interpretation of GPL 3 is that if you receive money for the use or distribution of the TriMesh Library or a derivative product, GPL 3 no longer applies.
+
+	Under those circumstances, the author expects and may legally pursue a reasoble share of the income. To avoid the complexity of agreements and negotiation, the author makes
+	no specific demands in this regard. Compensation of roughly 1% of net or $5 per user license seems appropriate, but is not legally binding.
+
+	In lay terms, if you make a profit by using the SpringHexMesh Project (violating the spirit of Open Source Software), I expect a reasonable share for my efforts.
+
+	Robert R Tipton - Author
+
+	Dark Sky Innovative Solutions http://darkskyinnovation.com/
+
+*/
+
+
+#include <tm_defines.h>
+
+#include <fstream>
+#include <algorithm>
+
+#include <hm_warmStart.h>
+#include <hm_grid.h>
+#include <hm_gridVert.h>
+#include <hm_gridCell.h>
+#include <hm_model.h>
+#include <hm_polylineArcLength.h>
+#include <hm_verifyReport.h>
+#include <meshProcessor.h>
+
+namespace HexahedralMesher {
+
+	using namespace std;
+
+	CWarmStart::CWarmStart(Grid& grid)
+		: _grid(grid)
+		, _numDivs(0, 0, 0)
+	{}
+
+	bool CWarmStart::read(const string& path) {
+		ifstream in(path);
+		if (!in.good()) {
+			cout << "Could not open warm start " << path << "\n";
+			return false;
+		}
+		return read(in);
+	}
+
+	bool CWarmStart::read(istream& in) {
+		string str0, str1;
+		int version;
+		in >> str0 >> str1 >> version;
+		if (str0 != "Mesher" || str1 != "version")
+			return false;
+
+		// Without the params only the same topology can be mapped
+		if (version >= 2 && !_priorParams.read(in))
+			return false;
+
+		_prior = make_shared<Grid>(_grid.getMesher());
+		if (!_prior->read(in)) {
+			_prior = nullptr;
+			return false;
+		}
+
+		_latticeDisp.clear();
+		if (version >= 2 && !buildLattice())
+			cout << "Warm start grid doesn't start with its params' lattice, it can only be copied\n";
+		return true;
+	}
+
+	bool CWarmStart::isSameTopology() const {
+		if (!_prior || _prior->numVerts() != _grid.numVerts() || _prior->numCells() != _grid.numCells())
+			return false;
+
+		for (size_t cellId = 0; cellId < _grid.numCells(); cellId++) {
+			if (_grid.cellExists(cellId) != _prior->cellExists(cellId))
+				return false;
+			if (!_grid.cellExists(cellId))
+				continue;
+			const auto& cell = _grid.getCell(cellId);
+			const auto& priorCell = _prior->getCell(cellId);
+			for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN; p++) {
+				if (cell.getVertIdx(p) != priorCell.getVertIdx(p))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	size_t CWarmStart::apply() {
+		if (!_prior)
+			return 0;
+
+		size_t numMoved;
+		if (isSameTopology()) {
+			numMoved = copyPositions();
+			cout << "Warm start copied " << numMoved << " of " << _grid.numVerts() << " vertices\n";
+		} else if (!_latticeDisp.empty()) {
+			numMoved = interpolatePositions();
+			cout << "Warm start interpolated " << numMoved << " of " << _grid.numVerts() << " vertices\n";
+		} else {
+			cout << "Warm start grid has a different topology and no lattice to interpolate\n";
+			return 0;
+		}
+
+		// The dependents follow their masters
+		_grid.clampDependentVerts();
+		return numMoved;
+	}
+
+	size_t CWarmStart::copyPositions() {
+		const int skipMask = CLAMP_FIXED | CLAMP_VERT | CLAMP_CELL_EDGE_CENTER | CLAMP_CELL_FACE_CENTER | CLAMP_GRID_TRI_PLANE;
+
+		size_t numMoved = 0;
+		for (size_t vertIdx = 0; vertIdx < _grid.numVerts(); vertIdx++) {
+			auto& vert = _grid.getVert(vertIdx);
+			if (vert.getClamp().matches(skipMask))
+				continue;
+
+			const auto& priorVert = _prior->getVert(vertIdx);
+			const TopolRef clamp(vert.getClamp());
+			const auto& priorClamp = priorVert.getClamp();
+			bool keepClamp = priorClamp.getClampType() == clamp.getClampType() && priorClamp.verify(_grid);
+			if (keepClamp)
+				vert.setClamp(_grid, priorClamp);
+
+			if (moveVert(vertIdx, priorVert.getPt()))
+				numMoved++;
+			else if (keepClamp)
+				vert.setClamp(_grid, clamp);
+		}
+		return numMoved;
+	}
+
+	size_t CWarmStart::interpolatePositions() {
+		const int skipMask = CLAMP_FIXED | CLAMP_VERT | CLAMP_CELL_EDGE_CENTER | CLAMP_CELL_FACE_CENTER | CLAMP_GRID_TRI_PLANE;
+
+		// Interpolate from the unmoved points, so each vertex gets the displacement of its own location
+		vector<Vector3d> startPts(_grid.numVerts());
+		for (size_t vertIdx = 0; vertIdx < _grid.numVerts(); vertIdx++)
+			startPts[vertIdx] = _grid.getVert(vertIdx).getPt();
+
+		size_t numMoved = 0;
+		for (size_t vertIdx = 0; vertIdx < _grid.numVerts(); vertIdx++) {
+			const auto& vert = _grid.getVert(vertIdx);
+			const auto& clamp = vert.getClamp();
+			if (clamp.matches(skipMask))
+				continue;
+
+			Vector3d disp;
+			if (!calcDisplacement(startPts[vertIdx], disp))
+				continue;
+
+			// Boundary vertices keep to their plane or line
+			if (clamp.matches(CLAMP_PERPENDICULAR)) {
+				Vector3d n = clamp.getVector().normalized();
+				disp -= disp.dot(n) * n;
+			} else if (clamp.matches(CLAMP_PARALLEL)) {
+				Vector3d v = clamp.getVector().normalized();
+				disp = disp.dot(v) * v;
+			}
+
+			if (disp.norm() > OPTIMIZER_TOL && moveVert(vertIdx, startPts[vertIdx] + disp))
+				numMoved++;
+		}
+		return numMoved;
+	}
+
+	bool CWarmStart::buildLattice() {
+		// Same divisions and vertex order as Grid::init
+		const auto& bbox = _priorParams.bounds;
+		Vector3d r = bbox.range();
+		for (int i = 0; i < 3; i++) {
+			_numDivs[i] = (int)(r[i] / _priorParams.calcMaxEdgeLength() + 0.5);
+			if (_numDivs[i] < 1)
+				return false;
+			_latticeStep[i] = r[i] / _numDivs[i];
+		}
+		_latticeMin = bbox.getMin();
+
+		const size_t nx = _numDivs[0] + 1, ny = _numDivs[1] + 1, nz = _numDivs[2] + 1;
+		size_t numLattice = nx * ny * nz;
+		if (_prior->numVerts() < numLattice)
+			return false;
+
+		// The vertex index of each lattice point, in the order Grid::init adds them
+		vector<size_t> latticeVert(numLattice, stm1);
+		size_t nextVert = 0;
+		for (int z = 0; z < _numDivs[2]; z++) {
+			for (int y = 0; y < _numDivs[1]; y++) {
+				for (int x = 0; x < _numDivs[0]; x++) {
+					for (int k = 0; k < 2; k++) {
+						for (int j = 0; j < 2; j++) {
+							for (int i = 0; i < 2; i++) {
+								size_t idx = (x + i) + nx * ((y + j) + ny * (z + k));
+								if (latticeVert[idx] == stm1)
+									latticeVert[idx] = nextVert++;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		_latticeDisp.resize(numLattice);
+		for (size_t z = 0; z < nz; z++) {
+			for (size_t y = 0; y < ny; y++) {
+				for (size_t x = 0; x < nx; x++) {
+					size_t idx = x + nx * (y + ny * z);
+					Vector3d latticePt = _latticeMin + Vector3d(x * _latticeStep[0], y * _latticeStep[1], z * _latticeStep[2]);
+					_latticeDisp[idx] = _prior->getVert(latticeVert[idx]).getPt() - latticePt;
+				}
+			}
+		}
+
+		// A grid from other params moves its lattice points by cells, not fractions of them
+		const double maxDisp = _latticeStep.minCoeff();
+		for (const auto& d : _latticeDisp) {
+			if (d.norm() > maxDisp) {
+				_latticeDisp.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool CWarmStart::calcDisplacement(const Vector3d& pt, Vector3d& disp) const {
+		if (!_priorParams.bounds.contains(pt))
+			return false;
+
+		int cellIdx[3];
+		double u[3];
+		for (int i = 0; i < 3; i++) {
+			double s = (pt[i] - _latticeMin[i]) / _latticeStep[i];
+			cellIdx[i] = min(max((int)s, 0), _numDivs[i] - 1);
+			u[i] = min(max(s - cellIdx[i], 0.0), 1.0);
+		}
+
+		const size_t nx = _numDivs[0] + 1, ny = _numDivs[1] + 1;
+		disp = Vector3d(0, 0, 0);
+		for (int k = 0; k < 2; k++) {
+			for (int j = 0; j < 2; j++) {
+				for (int i = 0; i < 2; i++) {
+					double w = (i ? u[0] : 1 - u[0]) * (j ? u[1] : 1 - u[1]) * (k ? u[2] : 1 - u[2]);
+					size_t idx = (cellIdx[0] + i) + nx * ((cellIdx[1] + j) + ny * (cellIdx[2] + k));
+					disp += w * _latticeDisp[idx];
+				}
+			}
+		}
+		return true;
+	}
+
+	bool CWarmStart::moveVert(size_t vertIdx, const Vector3d& pt) {
+		auto& vert = _grid.getVert(vertIdx);
+		const Vector3d oldPt = vert.getPt();
+		const TopolRef clamp(vert.getClamp());
+		Vector3d newPt = pt;
+
+		if (clamp.matches(CLAMP_EDGE)) {
+			// Onto the polyline, the clamp follows to the closest segment
+			const auto& modelPtr = _grid.getMesher().getModelPtr(clamp.getMeshIdx());
+			const auto& arcLen = modelPtr->getPolylineArcLength(clamp.getPolylineNumber());
+			size_t segIdx;
+			double dist, t;
+			arcLen.findClosestPoint(pt, clamp.getPolylineIndex(), segIdx, dist, t);
+			newPt = arcLen.getSegment(segIdx).interpolate(min(max(t, 0.0), 1.0));
+			if (segIdx != clamp.getPolylineIndex()) {
+				TopolRef newClamp(clamp);
+				newClamp.setPolylineIndex(segIdx);
+				vert.setClamp(_grid, newClamp);
+			}
+		}
+
+		_grid.setVertPos(vertIdx, newPt);
+		_grid.clampVertex(vertIdx);
+
+		VerifyReport report;
+		_grid.verifyClampPosition(vertIdx, report);
+		if (!report.empty()) {
+			vert.setClamp(_grid, clamp);
+			_grid.setVertPos(vertIdx, oldPt);
+			return false;
+		}
+		return true;
+	}
+
+}
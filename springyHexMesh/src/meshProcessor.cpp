@@ -31,13 +31,23 @@ This file is part of the SpringHexMesh Project.
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
 #include <set>
 
 #include <hm_types.h>
 #include <meshProcessor.h>
+#include <hm_globalOptimizer.h>
+#include <hm_multilevel.h>
+#include <hm_vertexScheduler.h>
+#include <hm_convergenceMonitor.h>
+#include <hm_laplacianSmoother.h>
 #include <hm_polylineFitter.h>
 #include <hm_splitter.h>
+#include <hm_warmStart.h>
 #include <hm_grid.h>
+#include <hm_gridCellEnergy.h>
 #include <readSTL.h>
 
 using namespace HexahedralMesher;
@@ -74,6 +84,7 @@ CMesher::CMesher(const ParamsRec& params)
 	, _grid(make_shared<Grid>(*this))
 	, _dumpObj(*_grid, dumpPath)
 {
+	_grid->setValidationTier(_params.validationTier, _params.validationSampleRate);
 }
 
 CMesher::~CMesher() {
@@ -117,12 +128,12 @@ void CMesher::save(const string& path) const {
 }
 
 void CMesher::save(ostream& out) const {
-	if (!_grid->verify()) {
+	if (!_grid->verifyChanges()) {
 		cout << "Failed to save because grid could not be verifid.\n";
 		return;
 	}
 
-	out << "Mesher version 1\n";
+	out << "Mesher version 2\n";
 		
 	_params.save(out);
 
@@ -150,12 +161,22 @@ bool CMesher::read(std::istream& in) {
 	if (str0 != "Mesher" || str1 != "version")
 		return false;
 
+	// Version 1 files didn't save the params. The grid's geometry comes from the file, the solver settings stay as set for this run.
 	ParamsRec newParams(_params);
-	if (!newParams.read(in))
-		return false;
+	if (version >= 2) {
+		ParamsRec fileParams;
+		if (!fileParams.read(in))
+			return false;
+		newParams.minEdgeLength = fileParams.minEdgeLength;
+		newParams.minGapSize = fileParams.minGapSize;
+		newParams.maxEdgeLength = fileParams.maxEdgeLength;
+		newParams.sharpAngleDeg = fileParams.sharpAngleDeg;
+		newParams.bounds = fileParams.bounds;
+	}
 
 
 	GridPtr newGrid = make_shared<Grid>(*this);
+	newGrid->setValidationTier(newParams.validationTier, newParams.validationSampleRate);
 	if (!newGrid->read(in))
 		return false;
 
@@ -402,10 +423,8 @@ void CMesher::clampBoundaryCorner(size_t vertIdx) {
 }
 
 void CMesher::clampBoundaries() {
-	_grid->iterateVerts([&](size_t vertIdx)->bool {
+	_grid->iterateVertsOfType(CLAMP_NONE, [&](size_t vertIdx)->bool {
 		auto& v = _grid->getVert(vertIdx);
-		if (v.getClampType() != CLAMP_NONE)
-			return true;
 		size_t numCells = v.getNumCells();
 		switch (numCells) {
 		case 8:
@@ -431,7 +450,83 @@ void CMesher::clampBoundaries() {
 void CMesher::intersectMesh() {
 }
 
-void CMesher::minimizeMesh(int steps, int energyMask, const string& filename) {
+void CMesher::runStage(const string& stageName, int energyMask, const string& filename) {
+	const auto& stage = _schedule.getStage(stageName);
+
+	int sweeps;
+	double seconds;
+	_schedule.allocate(stageName, sweeps, seconds);
+	cout << "Stage " << stageName << ": " << sweeps << " sweeps";
+	if (seconds > 0)
+		cout << ", " << seconds << "s";
+	cout << "\n";
+
+	// The stage only overrides the settings its schedule entry set, the rest come from the caller's params
+	const ParamsRec savedParams(_params);
+	if (stage._overrides & COptSchedule::OVR_MESH_SOLVER)
+		_params.meshSolver = stage._meshSolver;
+	if (stage._overrides & COptSchedule::OVR_VERTEX_SOLVER)
+		_params.vertexSolver = stage._vertexSolver;
+	if (stage._overrides & COptSchedule::OVR_MOVE_TOL)
+		_params.convergeMoveTol = stage._convergeMoveTol;
+	if (stage._overrides & COptSchedule::OVR_ENERGY_TOL)
+		_params.convergeEnergyTol = stage._convergeEnergyTol;
+
+	COptSchedule::StageResult result;
+	result._sweepsAllocated = sweeps;
+	result._secondsAllocated = seconds;
+
+	auto startTime = chrono::steady_clock::now();
+	const int numParts = stage._continuationSteps;
+	bool converged = false;
+	try {
+		for (int i = 0; i < numParts; i++) {
+			// Geometric steps between positive weights, so each part changes the energy by the same factor
+			double t = numParts > 1 ? i / (double)(numParts - 1) : 1.0;
+			if (stage._overrides & COptSchedule::OVR_K_COMPRESS) {
+				const auto& kc = stage._kCompress;
+				_params.kCompress = (kc[0] > 0 && kc[1] > 0) ? kc[0] * pow(kc[1] / kc[0], t) : kc[0] + t * (kc[1] - kc[0]);
+			}
+			if (stage._overrides & COptSchedule::OVR_K_BEND) {
+				const auto& kb = stage._kBend;
+				_params.kBend = (kb[0] > 0 && kb[1] > 0) ? kb[0] * pow(kb[1] / kb[0], t) : kb[0] + t * (kb[1] - kb[0]);
+			}
+
+			// Each part gets an even share of what's left, parts which converge early leave more for the later ones
+			int partSweeps = (sweeps - result._sweepsUsed) / (numParts - i);
+			if (seconds > 0) {
+				double remaining = seconds - chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+				if (remaining <= 0) {
+					converged = false;
+					break;
+				}
+				_params.sweepMaxSeconds = _params.priorityMaxSeconds = remaining / (numParts - i);
+			}
+			if (partSweeps <= 0) {
+				converged = false;
+				break;
+			}
+
+			// Running out of sweeps or time leaves the stage unconverged, so it has nothing to lend
+			StopReason stopReason = STOP_NONE;
+			size_t used = minimizeMesh(partSweeps, energyMask, filename, &stopReason);
+			result._sweepsUsed += (int)used;
+			converged = CConvergenceMonitor::isConverged(stopReason);
+		}
+	} catch (...) {
+		_params = savedParams;
+		throw;
+	}
+
+	result._secondsUsed = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	result._converged = converged;
+	_schedule.reportResult(stageName, result);
+
+	_params = savedParams;
+	_schedule.dumpResults(cout);
+}
+
+size_t CMesher::minimizeMesh(int steps, int energyMask, const string& filename, StopReason* stopReason) {
 	_grid->clearSearchTrees();
 
 	if (steps < 0) {
@@ -442,45 +537,99 @@ void CMesher::minimizeMesh(int steps, int energyMask, const string& filename) {
 #endif
 	}
 
+	Grid::ScopedDependentVerts dependentVerts(*_grid);
+
+	auto startTime = chrono::steady_clock::now();
+	if (_params.preSmoothPasses > 0) {
+		CLaplacianSmoother smoother(*_grid, energyMask, 6);
+		double maxMove = smoother.smooth(_params.preSmoothPasses);
+		cout << "Pre-smooth: " << _params.preSmoothPasses << " passes, last max move= " << maxMove
+			<< ", time: " << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s\n";
+	}
+
+	if (_params.meshSolver == MS_PRIORITY) {
+		// In sweeps worth of relaxations, rounded up so a partial sweep counts
+		size_t numVerts = max((size_t)1, _grid->numVerts());
+		return (minimizeMeshPriority(steps, energyMask, stopReason) + numVerts - 1) / numVerts;
+	} else if (_params.meshSolver != MS_VERTEX_SWEEP) {
+		return minimizeMeshGlobal(steps, energyMask, 0, stopReason);
+	}
+
 	ofstream logOut(savePath + "opt_log.csv");
 
 	const int numThreads = 6;
+	Grid::EnergyField energyField;
+
+	// Each sweep is followed by the coarse sweeps, the next sweep smooths the result. Together they make a V-cycle.
+	shared_ptr<CMultilevel> multilevel;
+	if (_params.coarseSweeps > 0) {
+		multilevel = make_shared<CMultilevel>(*_grid);
+		cout << "Multilevel: " << multilevel->numCoarseVerts() << " coarse vertices\n";
+		if (multilevel->numCoarseVerts() == 0)
+			multilevel = nullptr;
+	}
+
+	/*
+	Active set. After the first sweep, only vertices which moved, have a stencil neighbor which moved or have high energy are minimized.
+	Each vertex is a worklist entry written only by the thread visiting it, so the list is rebuilt in parallel.
+	*/
+	const double activeMoveTol = 1.0e-4 * _params.calcMinEdgeLength();
+	const double activeEnergyFactor = 4.0;
+	vector<Vector3d> prevPts;
+	vector<char> active, moved;
+	if (_params.activeSet) {
+		prevPts.resize(_grid->numVerts());
+		active.resize(_grid->numVerts(), 1);
+		moved.resize(_grid->numVerts(), 0);
+	}
+
+	CConvergenceMonitor::Params convergeParams;
+	convergeParams.moveTol = _params.convergeMoveTol * _params.calcMaxEdgeLength();
+	convergeParams.energyTol = _params.convergeEnergyTol;
+	convergeParams.window = _params.convergeWindow;
+	CConvergenceMonitor monitor(convergeParams);
+
 	for (int i = 0; i < steps; i++) {
 		checkStop();
+		if (_params.sweepMaxSeconds > 0 && chrono::duration<double>(chrono::steady_clock::now() - startTime).count() >= _params.sweepMaxSeconds) {
+			monitor.setStopReason(STOP_TIME_LIMIT);
+			break;
+		}
+		Grid::resetNumVertexEvaluations();
 		double maxMoveArr[numThreads], avgMoveArr[numThreads];
-		double maxEnergyArr[numThreads], avgEnergyArr[numThreads];
 		for (int j = 0; j < numThreads; j++) {
-			maxMoveArr[j]= avgMoveArr[j] = maxEnergyArr[j] = avgEnergyArr[j] = 0;
+			maxMoveArr[j]= avgMoveArr[j] = 0;
 		}
 
 		_grid->iterateVerts([&](size_t vertIdx)->bool {
 			auto& vert = _grid->getVert(vertIdx);
 			vert.copyToThread();
+			if (_params.activeSet)
+				prevPts[vertIdx] = vert.getPrimaryPt();
 			return true;
 		}, numThreads);
 
-		_grid->iterateVerts([&](size_t vertIdx)->bool {
+		// Tri planes follow their triangles, their frames are taken from the start of the sweep
+		_grid->updateConstraintFrames();
+
+		// Only the vertex types the minimizer can move
+		const int movableMask = CLAMP_NONE | CLAMP_EDGE | CLAMP_TRI | CLAMP_PERPENDICULAR | CLAMP_PARALLEL | CLAMP_GRID_TRI_PLANE;
+		_grid->iterateVertsOfType(energyMask & movableMask, [&](size_t vertIdx)->bool {
 			size_t threadNum = Grid::getThreadNumber();
 
 			if (vertIdx == 164) {
 				int dbgBreak = 1;
 			}
 
+			if (_params.activeSet && !active[vertIdx])
+				return true;
+
 			double move = _grid->minimizeVertexEnergy(logOut, vertIdx, energyMask);
 
 			if (move > maxMoveArr[threadNum])
 				maxMoveArr[threadNum] = move;
-			double e = _grid->calcVertexEnergy(vertIdx);
-
-			if (vertIdx == 164) {
-				_grid->calcVertexEnergy(vertIdx);
-			}
-
-			if (e > maxEnergyArr[threadNum])
-				maxEnergyArr[threadNum] = e;
 
 			avgMoveArr[threadNum] += move;
-			avgEnergyArr[threadNum] += e;
 			return true;
 			}, numThreads);
 
@@ -490,97 +639,275 @@ void CMesher::minimizeMesh(int steps, int energyMask, const string& filename) {
 			return true;
 			}, numThreads);
 
-		double avgMoveClamp;
+		// The solvers moved the dependent vertices with their masters, one pass places them exactly
+		_grid->clampDependentVerts();
+
+		double maxMove = 0, avgMove = 0;
+		for (int j = 0; j < numThreads; j++) {
+			if (maxMoveArr[j] > maxMove)
+				maxMove = maxMoveArr[j];
+
+			avgMove += avgMoveArr[j];
+		}
+		double evalsPerVert = Grid::getNumVertexEvaluations() / (double)_grid->numVerts();
 
-		avgMoveClamp = DBL_MAX;
-		for (int i = 0; i < 3 && avgMoveClamp > 1.0e-5; i++) {
-			double avgMoveClampArr[numThreads];
-			size_t numClamps[numThreads];
-			for (int i = 0; i < numThreads; i++) {
-				avgMoveClampArr[i] = 0;
-				numClamps[i] = 0;
+		if (multilevel) {
+			for (int j = 0; j < _params.coarseSweeps; j++) {
+				double avgCoarseMove;
+				double maxCoarseMove = multilevel->coarseSweep(avgCoarseMove);
+				cout << "  coarse " << j << ": Max move= " << maxCoarseMove << ", avgMove: " << avgCoarseMove << "\n";
 			}
+		}
 
-			_grid->iterateVerts([&](size_t vertIdx)->bool {
-				size_t threadNum = Grid::getThreadNumber();
-				double dist = _grid->clampVertexToCellEdgeCenter(vertIdx);
-				if (dist < DBL_MAX) {
-					avgMoveClampArr[threadNum] += fabs(dist);
-					numClamps[threadNum]++;
-				}
-				return true;
-			}, numThreads);
+		// Energy of the grid after the sweep, each cell is evaluated once
+		_grid->calcEnergyField(energyField, numThreads, false);
+		double maxEnergy = 0, totalEnergy = 0;
+		for (double e : energyField._vertEnergy) {
+			if (e > maxEnergy)
+				maxEnergy = e;
+			totalEnergy += e;
+		}
+
+		avgMove /= _grid->numVerts();
+		double avgEnergy = totalEnergy / _grid->numVerts();
 
+		bool converged = monitor.update(maxMove, totalEnergy);
+
+		cout << i << ": Max move= " << maxMove << ", avgMove: " << avgMove << ", maxEnergy: " << maxEnergy << ", avgEnergy: " << avgEnergy
+			<< ", evals/vert: " << evalsPerVert << ", decrease: " << monitor.getRelativeDecrease();
+
+		if (_params.activeSet) {
+			// Measured from the primary points, so clamp repairs and coarse moves count
 			_grid->iterateVerts([&](size_t vertIdx)->bool {
-				size_t threadNum = Grid::getThreadNumber();
-				double dist = _grid->clampVertexToTriPlane(vertIdx);
-				if (dist < DBL_MAX) {
-					avgMoveClampArr[threadNum] += fabs(dist);
-					numClamps[threadNum]++;
-				}
+				moved[vertIdx] = (_grid->getVert(vertIdx).getPrimaryPt() - prevPts[vertIdx]).norm() > activeMoveTol;
 				return true;
 			}, numThreads);
 
+			size_t numActiveArr[numThreads];
+			for (int j = 0; j < numThreads; j++)
+				numActiveArr[j] = 0;
+
+			double energyThreshold = activeEnergyFactor * avgEnergy;
 			_grid->iterateVerts([&](size_t vertIdx)->bool {
-				size_t threadNum = Grid::getThreadNumber();
-				double dist = _grid->clampVertexToCellFaceCenter(vertIdx);
-				if (dist < DBL_MAX) {
-					avgMoveClampArr[threadNum] += fabs(dist);
-					numClamps[threadNum]++;
+				bool isActive = moved[vertIdx] || energyField._vertEnergy[vertIdx] > energyThreshold;
+				if (!isActive) {
+					for (size_t cellIdx : _grid->getVert(vertIdx).getCellIndices()) {
+						const auto& cell = _grid->getCell(cellIdx);
+						for (CellVertPos p = LWR_FNT_LFT; p < CVP_UNKNOWN && !isActive; p++)
+							isActive = moved[cell.getVertIdx(p)] != 0;
+						if (isActive)
+							break;
+					}
 				}
-				return true;
-			}, numThreads);
-			_grid->iterateVerts([&](size_t vertIdx)->bool {
-				auto& vert = _grid->getVert(vertIdx);
-				vert.copyFromThread();
+				active[vertIdx] = isActive;
+				if (isActive)
+					numActiveArr[Grid::getThreadNumber()]++;
 				return true;
 			}, numThreads);
 
-			avgMoveClamp = 0;
-			for (int i = 0; i < numThreads; i++) {
-				if (numClamps[i] > 0)
-					avgMoveClamp += avgMoveClampArr[i] / (double)numClamps[i];
+			size_t numActive = 0;
+			for (int j = 0; j < numThreads; j++)
+				numActive += numActiveArr[j];
+
+			cout << ", active: " << numActive << " (" << (100.0 * numActive / _grid->numVerts()) << "%)\n";
+			if (numActive == 0) {
+				monitor.setStopReason(STOP_ACTIVE_SET_EMPTY);
+				converged = true;
 			}
+		} else
+			cout << "\n";
+
+		if (_reporter)
+			_reporter->report(*this, "grid_verts_changed");
+
+		if (converged)
+			break;
+
+#if DUMP_OBJ
+		if (!filename.empty() && (i % 5) == 0) {
+			string str;
+
+			str = filename + "_" + to_string(i);
+			_dumpObj.write(str);
+
+			str = filename + "Reduced_" + to_string(i);
+			_dumpObj.write(str, 2, CLAMP_VERT | CLAMP_EDGE | CLAMP_TRI);
+		}
+#endif
+	}
+
+	if (monitor.getStopReason() == STOP_NONE)
+		monitor.setStopReason(STOP_MAX_ITERATIONS);
+	cout << "Stopped after " << monitor.numIterations() << " sweeps: " << CConvergenceMonitor::getStopReasonStr(monitor.getStopReason())
+		<< ", energy: " << (energyField._cellEnergy.empty() ? 0 : _grid->calcTotalEnergy(energyField)) << ", time: " << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s\n";
+
+	_grid->rebuildVertTree();
+	if (stopReason)
+		*stopReason = monitor.getStopReason();
+	return monitor.numIterations();
+}
+
+int CMesher::minimizeMeshGlobal(int maxIterations, int energyMask, double targetEnergy, StopReason* stopReason) {
+	_grid->clearSearchTrees();
+
+	const int numThreads = 6;
+	CGlobalOptimizer optimizer(*_grid, _params.meshSolver, energyMask, numThreads);
+	cout << (_params.meshSolver == MS_FIRE ? "FIRE: " : "L-BFGS: ") << optimizer.numDofs() << " degrees of freedom, energy: " << optimizer.getEnergy() << "\n";
+
+	// A run to a target energy is a benchmark, it stops on the target rather than the tolerances
+	CConvergenceMonitor::Params convergeParams;
+	if (targetEnergy <= 0) {
+		convergeParams.moveTol = _params.convergeMoveTol * _params.calcMaxEdgeLength();
+		convergeParams.energyTol = _params.convergeEnergyTol;
+		// The line search never accepts a rise, FIRE's inertia can climb for a few steps
+		convergeParams.stopOnStall = _params.meshSolver == MS_LBFGS;
+	}
+	convergeParams.window = _params.convergeWindow;
+	CConvergenceMonitor monitor(convergeParams);
 
-			avgMoveClamp /= (double)numThreads;
+	auto startTime = chrono::steady_clock::now();
+	vector<Vector3d> prevPts(_grid->numVerts());
+	int i;
+	for (i = 0; i < maxIterations && optimizer.getEnergy() > targetEnergy; i++) {
+		checkStop();
+		if (_params.sweepMaxSeconds > 0 && chrono::duration<double>(chrono::steady_clock::now() - startTime).count() >= _params.sweepMaxSeconds) {
+			monitor.setStopReason(STOP_TIME_LIMIT);
+			break;
 		}
+		for (size_t vertIdx = 0; vertIdx < prevPts.size(); vertIdx++)
+			prevPts[vertIdx] = _grid->getVert(vertIdx).getPt();
 
+		if (!optimizer.step()) {
+			monitor.setStopReason(STOP_STALLED);
+			break;
+		}
+
+		// Same statistics as the vertex sweeps
 		double maxMove = 0, avgMove = 0;
-		double maxEnergy = 0, avgEnergy = 0;
-		for (int j = 0; j < numThreads; j++) {
-			if (maxMoveArr[j] > maxMove)
-				maxMove = maxMoveArr[j];
-			if (maxEnergyArr[j] > maxEnergy)
-				maxEnergy = maxEnergyArr[j];
+		for (size_t vertIdx = 0; vertIdx < prevPts.size(); vertIdx++) {
+			double move = (_grid->getVert(vertIdx).getPt() - prevPts[vertIdx]).norm();
+			if (move > maxMove)
+				maxMove = move;
+			avgMove += move;
+		}
 
-			avgMove += avgMoveArr[j];
-			avgEnergy += avgEnergyArr[j];
+		double maxEnergy = 0, avgEnergy = 0;
+		for (double e : optimizer.getEnergyField()._vertEnergy) {
+			if (e > maxEnergy)
+				maxEnergy = e;
+			avgEnergy += e;
 		}
 
 		avgMove /= _grid->numVerts();
 		avgEnergy /= _grid->numVerts();
 
-		cout << i << ": Max move= " << maxMove << ", avgMove: " << avgMove << ", maxEnergy: " << maxEnergy << ", avgEnergy: " << avgEnergy << "\n";
+		bool converged = monitor.update(maxMove, optimizer.getEnergy());
 
-		_reporter->report(*this, "grid_verts_changed");
+		cout << i << ": Max move= " << maxMove << ", avgMove: " << avgMove << ", maxEnergy: " << maxEnergy << ", avgEnergy: " << avgEnergy
+			<< ", evaluations: " << optimizer.getNumEvaluations() << ", decrease: " << monitor.getRelativeDecrease() << "\n";
 
-#if DUMP_OBJ
-		if (!filename.empty() && (i % 5) == 0) {
-			string str;
+		if (_reporter)
+			_reporter->report(*this, "grid_verts_changed");
 
-			str = filename + "_" + to_string(i);
-			_dumpObj.write(str);
+		if (converged) {
+			// Count the iteration which converged
+			i++;
+			break;
+		}
+	}
 
-			str = filename + "Reduced_" + to_string(i);
-			_dumpObj.write(str, 2, CLAMP_VERT | CLAMP_EDGE | CLAMP_TRI);
+	if (monitor.getStopReason() == STOP_NONE)
+		monitor.setStopReason(i >= maxIterations ? STOP_MAX_ITERATIONS : STOP_TARGET_ENERGY);
+	cout << "Stopped after " << i << " iterations: " << CConvergenceMonitor::getStopReasonStr(monitor.getStopReason())
+		<< ", energy: " << optimizer.getEnergy() << ", time: " << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s\n";
+
+	_grid->rebuildVertTree();
+	if (stopReason)
+		*stopReason = monitor.getStopReason();
+	return i;
+}
+
+size_t CMesher::minimizeMeshPriority(int steps, int energyMask, StopReason* stopReason) {
+	_grid->clearSearchTrees();
+
+	ofstream logOut(savePath + "opt_log.csv");
+
+	const int numThreads = 6;
+	// The tighter of the priority and sweep time limits
+	double maxSeconds = _params.priorityMaxSeconds;
+	if (_params.sweepMaxSeconds > 0 && (maxSeconds <= 0 || _params.sweepMaxSeconds < maxSeconds))
+		maxSeconds = _params.sweepMaxSeconds;
+
+	size_t maxRelaxations = _params.priorityMaxRelaxations;
+	if (maxRelaxations == 0 && maxSeconds <= 0)
+		maxRelaxations = (size_t)steps * _grid->numVerts();
+
+	CVertexScheduler scheduler(*_grid, energyMask, numThreads);
+	cout << "Priority: " << scheduler.numQueued() << " vertices queued\n";
+
+	CConvergenceMonitor::Params convergeParams;
+	convergeParams.moveTol = _params.convergeMoveTol * _params.calcMaxEdgeLength();
+	convergeParams.energyTol = _params.convergeEnergyTol;
+	convergeParams.window = _params.convergeWindow;
+	CConvergenceMonitor monitor(convergeParams);
+
+	// Run in chunks of one sweep's worth of relaxations to report progress, check for stop and test convergence
+	auto startTime = chrono::steady_clock::now();
+	Grid::EnergyField energyField;
+	vector<Vector3d> prevPts(_grid->numVerts());
+	size_t numRelaxations = 0;
+	for (int i = 0; maxRelaxations == 0 || numRelaxations < maxRelaxations; i++) {
+		checkStop();
+		size_t chunk = _grid->numVerts();
+		if (maxRelaxations > 0)
+			chunk = min(chunk, maxRelaxations - numRelaxations);
+		double seconds = 0;
+		if (maxSeconds > 0) {
+			seconds = maxSeconds - chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+			if (seconds <= 0) {
+				monitor.setStopReason(STOP_TIME_LIMIT);
+				break;
+			}
 		}
 
-		if (maxMove < 0.001 * _params.calcMaxEdgeLength())
+		for (size_t vertIdx = 0; vertIdx < prevPts.size(); vertIdx++)
+			prevPts[vertIdx] = _grid->getVert(vertIdx).getPt();
+
+		size_t numRun = scheduler.run(seconds, chunk, logOut);
+		numRelaxations += numRun;
+
+		double maxMove = 0;
+		for (size_t vertIdx = 0; vertIdx < prevPts.size(); vertIdx++)
+			maxMove = max(maxMove, (_grid->getVert(vertIdx).getPt() - prevPts[vertIdx]).norm());
+
+		// Only the cells around relaxed vertices miss the energy cache
+		_grid->calcEnergyField(energyField, numThreads, false);
+		double totalEnergy = _grid->calcTotalEnergy(energyField);
+		bool converged = monitor.update(maxMove, totalEnergy);
+
+		cout << i << ": relaxations: " << numRelaxations << ", queued: " << scheduler.numQueued() << ", Max move= " << maxMove
+			<< ", energy: " << totalEnergy << ", decrease: " << monitor.getRelativeDecrease() << "\n";
+
+		if (_reporter)
+			_reporter->report(*this, "grid_verts_changed");
+
+		if (numRun < chunk && scheduler.numQueued() == 0) {
+			monitor.setStopReason(STOP_ACTIVE_SET_EMPTY);
+			break;
+		}
+		if (converged)
 			break;
-#endif
 	}
 
+	if (monitor.getStopReason() == STOP_NONE)
+		monitor.setStopReason(STOP_MAX_ITERATIONS);
+	cout << "Stopped after " << numRelaxations << " relaxations: " << CConvergenceMonitor::getStopReasonStr(monitor.getStopReason())
+		<< ", time: " << chrono::duration<double>(chrono::steady_clock::now() - startTime).count() << "s\n";
+
 	_grid->rebuildVertTree();
+	if (stopReason)
+		*stopReason = monitor.getStopReason();
+	return numRelaxations;
 }
 
 void CMesher::splitCells(int numSplits) {
@@ -617,7 +944,7 @@ void CMesher::divideMesh(int numDivisions) {
 		_dumpObj.write(splitName + "Reduced1", 1, mask);
 		_dumpObj.write(splitName + "Reduced2", 2, mask);
 #endif
-		minimizeMesh(25, -1);
+		runStage("divide", -1);
 
 #if DUMP_OBJ
 		string minName("divMin_");
@@ -719,7 +1046,7 @@ void CMesher::putCornersOnSharpEdges() {
 		}
 	}
 
-	if (!_grid->verify())
+	if (!_grid->verifyChanges())
 		cout << "Bad mesh after polyline fit\n";
 
 #if DUMP_OBJ
@@ -727,7 +1054,7 @@ void CMesher::putCornersOnSharpEdges() {
 	_dumpObj.write("alignedMeshPreSplitPreMinReduced", 1, CLAMP_VERT | CLAMP_EDGE | CLAMP_TRI);
 #endif
 
-	minimizeMesh(50, -1);
+	runStage("polylineFit", -1);
 
 #if DUMP_OBJ
 	_dumpObj.write("alignedMeshPostSplitPreMin");
@@ -760,7 +1087,7 @@ void CMesher::putCornersOnSharpEdges() {
 	_dumpObj.writeCells("clampedCells", divider.getClampedCells());
 #endif
 
-	if (!_grid->verify())
+	if (!_grid->verifyChanges())
 		cout << "Bad mesh after diagonal split\n";
 }
 
@@ -816,18 +1143,41 @@ void CMesher::makeInitialGrid() {
 	save(savePath + "initial.grid");
 }
 
+bool CMesher::applyWarmStart() {
+	if (_warmStartPath.empty())
+		return false;
+
+	CWarmStart warmStart(*_grid);
+	if (!warmStart.read(_warmStartPath)) {
+		cout << "Could not read warm start " << _warmStartPath << "\n";
+		return false;
+	}
+
+	bool sameTopology = warmStart.isSameTopology();
+	size_t numMoved = warmStart.apply();
+	if (_reporter)
+		_reporter->report(*this, "grid_verts_changed");
+
+	if (!_grid->verifyChanges())
+		cout << "Bad mesh after warm start\n";
+	return sameTopology && numMoved > 0;
+}
+
 ErrorCode CMesher::run() {
 	try {
 		init();
 
 		if (true || !read(savePath + "postFit.grid")) {
-			if (!read(savePath + "preFit.grid")) {
+			// A warm start replaces the saved preFit state
+			if (!_warmStartPath.empty() || !read(savePath + "preFit.grid")) {
 				if (!read(savePath + "initial.grid")) {
 					makeInitialGrid();
 				}
 				_reporter->report(*this, "grid_topol_change");
 //				return NO_ERR;
-				minimizeMesh(75, -1);
+				// An interpolated warm start still needs the sweeps, they stop early on convergence
+				if (!applyWarmStart())
+					runStage("preFit", -1);
 
 #if DUMP_OBJ
 				_dumpObj.write("preFit", 0);
@@ -855,7 +1205,7 @@ ErrorCode CMesher::run() {
 		_reporter->report(*this, "grid_topol_change");
 
 		GridVert::clearHistory();
-		minimizeMesh(75, -1);
+		runStage("aligned", -1);
 		GridVert::writeHistory(savePath + "vertHistory.csv");
 
 #if DUMP_OBJ
@@ -875,6 +1225,136 @@ ErrorCode CMesher::run() {
 	return NO_ERR;
 }
 
+void CMesher::loadBenchmarkStart(stringstream& startState) {
+	init();
+
+	if (!read(savePath + "preFit.grid")) {
+		if (!read(savePath + "initial.grid")) {
+			makeInitialGrid();
+		}
+	}
+
+	_grid->save(startState);
+}
+
+bool CMesher::restoreBenchmarkStart(stringstream& startState) {
+	_grid->clear();
+	startState.clear();
+	startState.seekg(0);
+	return _grid->read(startState);
+}
+
+ErrorCode CMesher::benchmarkOrthoModels(int steps) {
+	// Later runs in this session keep the model they were configured with
+	const OrthoModel startModel = _params.orthoModel;
+	try {
+		stringstream startState;
+		loadBenchmarkStart(startState);
+
+		const OrthoModel models[] = { ORTHO_ANGLE, ORTHO_DOT_PRODUCT };
+		const char* modelNames[] = { "angle", "dot product" };
+		for (int m = 0; m < 2; m++) {
+			if (!restoreBenchmarkStart(startState)) {
+				_params.orthoModel = startModel;
+				return UNKNOWN_ERR;
+			}
+
+			_params.orthoModel = models[m];
+
+			auto startTime = chrono::steady_clock::now();
+			size_t sweeps = minimizeMesh(steps, -1);
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+			// Score every result with the angle model, so the energies are comparable
+			GridEnergy scoreCal(*_grid);
+			size_t numCells = 0;
+			double maxErr = 0, avgErr = 0, bendEnergy = 0;
+			_grid->iterateCells([&](size_t cellIdx)->bool {
+				const auto& cell = _grid->getCell(cellIdx);
+				double err = scoreCal.calcMaxCornerAngleError(cell);
+				if (err > maxErr)
+					maxErr = err;
+				avgErr += err;
+				bendEnergy += scoreCal.calcBendEnergy(cell);
+				numCells++;
+				return true;
+			});
+			if (numCells > 0)
+				avgErr /= numCells;
+
+			const double toDeg = 180.0 / EIGEN_PI;
+			cout << "Ortho model: " << modelNames[m] << "\n";
+			// The sweeps can stop early on the convergence tolerances, the time is per sweep run
+			cout << "  sweeps             : " << sweeps << " of " << steps << "\n";
+			cout << "  time               : " << seconds << " s, " << (sweeps > 0 ? 1000 * seconds / sweeps : 0) << " ms/sweep\n";
+			cout << "  max corner error   : " << (maxErr * toDeg) << " deg\n";
+			cout << "  avg cell max error : " << (avgErr * toDeg) << " deg\n";
+			cout << "  angle bend energy  : " << bendEnergy << "\n";
+		}
+	}
+	catch (StopException) {
+		_params.orthoModel = startModel;
+		return NO_ERR;
+	}
+	_params.orthoModel = startModel;
+	return NO_ERR;
+}
+
+ErrorCode CMesher::benchmarkMeshSolvers(int steps) {
+	const MeshSolver startSolver = _params.meshSolver;
+	try {
+		stringstream startState;
+		loadBenchmarkStart(startState);
+
+		const int numThreads = 6;
+		Grid::EnergyField energyField;
+		_grid->calcEnergyField(energyField, numThreads, false);
+		double startEnergy = _grid->calcTotalEnergy(energyField);
+
+		_params.meshSolver = MS_VERTEX_SWEEP;
+		auto startTime = chrono::steady_clock::now();
+		size_t sweeps = minimizeMesh(steps, -1);
+		double sweepSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+		_grid->calcEnergyField(energyField, numThreads, false);
+		double sweepEnergy = _grid->calcTotalEnergy(energyField);
+
+		cout << "Start energy : " << startEnergy << "\n";
+		cout << "Vertex sweep : " << sweeps << " sweeps, " << sweepSeconds << " s, energy: " << sweepEnergy << "\n";
+
+		// Each global solver starts from the same grid and runs until it reaches the energy the sweeps ended with
+		const MeshSolver solvers[] = { MS_LBFGS, MS_FIRE };
+		const char* solverNames[] = { "L-BFGS", "FIRE" };
+		for (int m = 0; m < 2; m++) {
+			if (!restoreBenchmarkStart(startState)) {
+				_params.meshSolver = startSolver;
+				return UNKNOWN_ERR;
+			}
+			_params.meshSolver = solvers[m];
+			startTime = chrono::steady_clock::now();
+			int iterations;
+			{
+				// minimizeMesh builds these for the sweep, without them the gradient would leave out the hanging vertices
+				Grid::ScopedDependentVerts dependentVerts(*_grid);
+				iterations = minimizeMeshGlobal(200 * steps, -1, sweepEnergy);
+			}
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+			_grid->calcEnergyField(energyField, numThreads, false);
+			double energy = _grid->calcTotalEnergy(energyField);
+
+			cout << solverNames[m] << " : " << iterations << " iterations, " << seconds << " s, energy: " << energy;
+			if (energy > sweepEnergy)
+				cout << " (did not reach the sweep energy)";
+			cout << "\n";
+		}
+	}
+	catch (StopException) {
+		_params.meshSolver = startSolver;
+		return NO_ERR;
+	}
+	_params.meshSolver = startSolver;
+	return NO_ERR;
+}
+
 void CMesher::dumpModelObj(const string& filenameRoot) const {
 	if (!_modelPtrs.empty()) {
 		string filename(filenameRoot + ".obj");
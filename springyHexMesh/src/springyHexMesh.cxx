@@ -60,14 +60,61 @@ int main(int numArgs, char **args)
 	params.minEdgeLength = 0.1;
 	params.sharpAngleDeg = 45.0;
 
+	COptSchedule schedule;
+	string warmStartPath;
+	for (int i = 1; i < numArgs; i++) {
+		if (string(args[i]) == "-schedule" && i + 1 < numArgs) {
+			if (!schedule.read(args[++i]))
+				return 1;
+		} else if (string(args[i]) == "-warmStart" && i + 1 < numArgs) {
+			warmStartPath = args[++i];
+		} else if (string(args[i]) == "-newton")
+			params.vertexSolver = VS_NEWTON;
+		else if (string(args[i]) == "-reduced")
+			params.vertexSolver = VS_REDUCED;
+		else if (string(args[i]) == "-lbfgs")
+			params.meshSolver = MS_LBFGS;
+		else if (string(args[i]) == "-fire")
+			params.meshSolver = MS_FIRE;
+		else if (string(args[i]) == "-priority")
+			params.meshSolver = MS_PRIORITY;
+		else if (string(args[i]) == "-preSmooth")
+			params.preSmoothPasses = 10;
+		else if (string(args[i]) == "-multilevel")
+			params.coarseSweeps = 2;
+		else if (string(args[i]) == "-activeSet")
+			params.activeSet = true;
+		else if (string(args[i]) == "-noValidation")
+			params.validationTier = VT_OFF;
+		else if (string(args[i]) == "-sampledValidation")
+			params.validationTier = VT_SAMPLED;
+		else if (string(args[i]) == "-paranoid")
+			params.validationTier = VT_PARANOID;
+	}
+
 	TestReporterPtr reporter = make_shared<TestReporter>();
 	CMesherPtr mesher = make_shared< CMesher>(params);
+	mesher->setSchedule(schedule);
+	mesher->setWarmStart(warmStartPath);
 	mesher->reset();
 
 
 	bool fine = false;
 	if (!mesher->addFile(downloads, fine ? "Spinnaker Slots 5 - Fine.stl" : "Spinnaker Slots 5 - Coarse.stl"))
 		return 1;
+
+	if (numArgs > 1 && string(args[1]) == "-benchOrtho") {
+		int steps = numArgs > 2 ? atoi(args[2]) : 25;
+		mesher->benchmarkOrthoModels(steps);
+		return 0;
+	}
+
+	if (numArgs > 1 && string(args[1]) == "-benchSolvers") {
+		int steps = numArgs > 2 ? atoi(args[2]) : 25;
+		mesher->benchmarkMeshSolvers(steps);
+		return 0;
+	}
+
 	mesher->run();
 
 	return 0;